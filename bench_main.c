@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <locale.h>
+#include "engine.h"
+#include "eval.h"
+#include "movegen.h"
+#include "pieces.h"
+#include "policy.h"
+#include "rng.h"
+#include "render.h"
+#include "snapshot.h"
+
+#ifndef TETRIS_BUILD_TYPE
+#define TETRIS_BUILD_TYPE   "unknown"
+#endif
+#define SAMPLES             7
+
+typedef struct {
+    const char *name;
+    const char *what;
+    void (*setup)(void);
+    void (*run)(long iters);
+    bool terminal;                      // draws to the terminal, needs `renderer->init()` first
+} bench_t;
+
+static volatile unsigned sink;          // results go here so the compiler cannot drop the work
+static engine_t base, game, alt;
+static movegen_t gen;
+static eval_batch_t batch;
+static snapshot_t snap, fork_snap;
+static const renderer_t *renderer = &render_curses;
+static FILE *err;                       // stderr, which is /dev/null while a renderer is up
+static rng_t rng, fork_rng;
+
+// a mid-game board: the greedy policy plays a few pieces
+static void setup_board(void)
+{
+    engine_init(&base, 1);
+    for (int i = 0; i < 12; i++)
+        policy_play(&base);
+    game = base;
+}
+
+// four rows full except column 0, with an I tetromino standing above the gap
+static void setup_tetris(void)
+{
+    engine_init(&base, 1);
+    for (int y = PF_H - 4; y < PF_H; y++)
+        for (int x = 1; x < PF_W; x++) {
+            base.rows[y] |= ROW_BIT(x);
+            base.colors[y][x] = O_tet;
+        }
+    engine_rebuild(&base);
+    base.tetromino = (tetromino_t){.shape = I_tet, .x = -2, .y = TETROMINO_SPAWN_Y, .rotation = 1, .falling = true,
+                                   .bitmap = PIECE(I_tet, 1)->bitmap};
+}
+
+static void run_copy(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        game = base;
+        sink += game.rows[PF_H - 1];
+    }
+}
+
+// the fork search code would make of a snapshot
+static void setup_snapshot(void)
+{
+    setup_board();
+    snapshot_save(&snap, &base);
+}
+
+static void run_snap_copy(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        fork_snap = snap;
+        sink += fork_snap.rows[PF_H - 1];
+    }
+}
+
+static void run_snap_save(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        snapshot_save(&snap, &base);
+        sink += snap.check;
+    }
+}
+
+static void run_snap_load(long iters)
+{
+    for (long i = 0; i < iters; i++)
+        sink += (unsigned)snapshot_load(&game, &snap);
+}
+
+static void run_shift(long iters)
+{
+    for (long i = 0; i < iters; i++)
+        sink += engine_step(&game, (i & 1) ? IN_LEFT : IN_RIGHT);
+}
+
+static void run_rotate(long iters)
+{
+    for (long i = 0; i < iters; i++)
+        sink += engine_step(&game, IN_CW);
+}
+
+// gravity and locking as a game at level 10 plays them, starting over whenever it ends
+static void setup_tick(void)
+{
+    setup_board();
+    base.level = 10;
+    game = base;
+}
+
+static void run_tick(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        sink += engine_step(&game, IN_TICK);
+        if (!game.running)
+            game = base;
+    }
+}
+
+// hard drop onto the stack without clearing anything, includes one engine copy (see `copy`)
+static void run_lock(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        game = base;
+        sink += engine_step(&game, IN_HARD_DROP);
+    }
+}
+
+static void run_movegen(long iters)
+{
+    for (long i = 0; i < iters; i++)
+        sink += (unsigned)movegen(&gen, &game, false);
+}
+
+// 16 boards, one per placement of the current tetromino
+static void setup_eval(void)
+{
+    engine_t child;
+
+    setup_board();
+    eval_reset(&batch);
+    movegen(&gen, &base, false);
+    for (int i = 0; i < gen.count && i < EVAL_LANES; i++) {
+        child = base;
+        child.tetromino.x = gen.placements[i].x;
+        child.tetromino.y = gen.placements[i].y;
+        child.tetromino.rotation = gen.placements[i].rotation;
+        child.tetromino.bitmap = PIECE(child.tetromino.shape, gen.placements[i].rotation)->bitmap;
+        engine_step(&child, IN_HARD_DROP);
+        eval_add(&batch, &child, child.lines - base.lines);
+    }
+}
+
+static void run_eval(long iters)
+{
+    const eval_weights_t w = {-510, -356, -184, -40, 760};
+    int32_t out[EVAL_LANES];
+
+    for (long i = 0; i < iters; i++) {
+        eval_score(&batch, &w, out, EVAL_AUTO);
+        sink += (unsigned)out[i & (EVAL_LANES - 1)];
+    }
+}
+
+// a frame where only the tetromino moved, then one where every cell of the playfield changed
+static void setup_frames(void)
+{
+    setup_board();
+    alt = base;
+    engine_step(&alt, IN_LEFT);
+    renderer->draw(&base);
+}
+
+static void run_frames(long iters)
+{
+    for (long i = 0; i < iters; i++)
+        renderer->draw((i & 1) ? &alt : &base);
+}
+
+static void setup_frames_full(void)
+{
+    setup_board();
+    alt = base;
+    for (int y = PF_BUFF_SIZE; y < PF_H; y++)
+        for (int x = 0; x < PF_W; x++)
+            alt.colors[y][x] = (uint8_t)(base.colors[y][x] ? 0 : (x + y) % BAG_SIZE + 1);
+    alt.score++;
+    renderer->draw(&base);
+}
+
+// the parent as a game would hold it, and a check that the fork takes the parent's draws high half first
+static void setup_rng(void)
+{
+    rng_t copy;
+    uint32_t draws[4];
+
+    rng_seed(&rng, 1, 0);
+    copy = rng;
+    for (int i = 0; i < 4; i++)
+        draws[i] = rng_next(&copy);
+    rng_seed(&copy, (uint64_t)draws[0] << 32 | draws[1], (uint64_t)draws[2] << 32 | draws[3]);
+    rng_fork(&rng, &fork_rng);
+    if (fork_rng.state != copy.state || fork_rng.inc != copy.inc) {
+        fprintf(err, "rng_fork: the child does not match the parent's next four draws\n");
+        exit(1);
+    }
+}
+
+static void run_rng_fork(long iters)
+{
+    for (long i = 0; i < iters; i++) {
+        rng_fork(&rng, &fork_rng);
+        sink += rng_next(&fork_rng);
+    }
+}
+
+static const bench_t benches[] = {
+    {"copy", "engine_t copy, the baseline of lock and lock_clear4", setup_board, run_copy, false},
+    {"snap_copy", "snapshot_t copy, a fork", setup_snapshot, run_snap_copy, false},
+    {"snap_save", "pack a game into a snapshot", setup_snapshot, run_snap_save, false},
+    {"snap_load", "unpack a snapshot and rebuild the metrics", setup_snapshot, run_snap_load, false},
+    {"shift", "collision() translation, left and right", setup_board, run_shift, false},
+    {"rotate", "collision() rotation with SRS kicks", setup_board, run_rotate, false},
+    {"tick", "one fixed timestep, gravity and locking", setup_tick, run_tick, false},
+    {"lock", "tet2playfield() through a hard drop", setup_board, run_lock, false},
+    {"lock_clear4", "tet2playfield() and a four line clear", setup_tetris, run_lock, false},
+    {"movegen", "every reachable placement of one tetromino", setup_board, run_movegen, false},
+    {"eval_batch", "score 16 boards at once", setup_eval, run_eval, false},
+    {"rng_fork", "derive an independent PCG32 stream", setup_rng, run_rng_fork, false},
+    {"frame_move", "draw a frame where the tetromino moved", setup_frames, run_frames, true},
+    {"frame_full", "draw a frame where every cell changed", setup_frames_full, run_frames, true},
+};
+
+static int64_t elapsed_ns(const struct timespec *s, const struct timespec *e)
+{
+    return (int64_t)(e->tv_sec - s->tv_sec) * 1000000000 + (e->tv_nsec - s->tv_nsec);
+}
+
+static int by_value(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// time `B`: iterations are doubled until one sample lasts `sample_ns`, then SAMPLES samples give the min and median
+static void measure(const bench_t *B, const int64_t sample_ns, double *min, double *median, long *iters)
+{
+    struct timespec s, e;
+    double ns[SAMPLES];
+    long n = 1;
+
+    B->setup();
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &s);
+        B->run(n);
+        clock_gettime(CLOCK_MONOTONIC, &e);
+        if (elapsed_ns(&s, &e) >= sample_ns || n > (1L << 40))
+            break;
+        n *= 2;
+    }
+    for (int i = 0; i < SAMPLES; i++) {
+        B->setup();
+        clock_gettime(CLOCK_MONOTONIC, &s);
+        B->run(n);
+        clock_gettime(CLOCK_MONOTONIC, &e);
+        ns[i] = (double)elapsed_ns(&s, &e) / (double)n;
+    }
+    qsort(ns, SAMPLES, sizeof(double), by_value);
+    *min = ns[0];
+    *median = ns[SAMPLES / 2];
+    *iters = n;
+}
+
+// run every benchmark whose name contains the filter and print ns/op as a table or as JSON
+int main(int argc, char *argv[])
+{
+    const char *filter = "";
+    int64_t sample_ns = 20000000;
+    int opt, json = 0, out_fd = STDOUT_FILENO, terminal = 0, first = 1;
+    FILE *out = stdout;
+
+    err = stderr;
+    while ((opt = getopt(argc, argv, "jf:t:R:")) != -1) {
+        switch (opt) {
+            case 'j':
+                json = 1;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 't':
+                sample_ns = atol(optarg) * 1000000;
+                break;
+            case 'R':
+                if (!(renderer = render_find(optarg))) {
+                    fprintf(stderr, "%s: no renderer '%s', try curses or ansi\n", argv[0], optarg);
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-j] [-f name-filter] [-t ms-per-sample] [-R curses|ansi]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // the renderer draws to stdout, which goes to /dev/null while the results keep the real one. Only the renderer is
+    // started and it never sees the user's terminal, the game's input layer would put it into raw mode
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+        terminal |= benches[i].terminal && strstr(benches[i].name, filter);
+    if (terminal) {
+        int null_fd = open("/dev/null", O_WRONLY), err_fd;
+        if (null_fd < 0 || (out_fd = dup(STDOUT_FILENO)) < 0 || !(out = fdopen(out_fd, "w")) ||
+            (err_fd = dup(STDERR_FILENO)) < 0 || !(err = fdopen(err_fd, "w")))
+            return 1;
+        // ncurses sets the terminal modes through stderr when stdout is not a terminal, so that goes too
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+        setenv("TERM", "xterm-256color", 0);
+        setenv("LINES", "40", 1);
+        setenv("COLUMNS", "100", 1);
+        setlocale(LC_ALL, "");
+        renderer->init();
+    }
+
+    if (json)
+        fprintf(out, "{\"build\": \"%s\", \"board\": \"%dx%d\", \"renderer\": \"%s\", \"benchmarks\": [",
+                TETRIS_BUILD_TYPE, PF_W, BOARD_H, renderer->name);
+    else
+        fprintf(out, "build: %s, board: %dx%d, renderer: %s\n%-12s %12s %12s %12s  %s\n", TETRIS_BUILD_TYPE, PF_W,
+                BOARD_H, renderer->name, "name", "min ns/op", "median ns/op", "iterations", "measures");
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        const bench_t *B = &benches[i];
+        double min, median;
+        long iters;
+
+        if (!strstr(B->name, filter))
+            continue;
+        measure(B, sample_ns, &min, &median, &iters);
+        if (json)
+            fprintf(out, "%s\n  {\"name\": \"%s\", \"ns_per_op\": %.2f, \"median_ns_per_op\": %.2f, \"iterations\": %ld}",
+                    first ? "" : ",", B->name, min, median, iters);
+        else
+            fprintf(out, "%-12s %12.2f %12.2f %12ld  %s\n", B->name, min, median, iters, B->what);
+        fflush(out);
+        first = 0;
+    }
+
+    if (json)
+        fprintf(out, "\n]}\n");
+    if (terminal)
+        renderer->close();
+    return 0;
+}
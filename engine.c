@@ -0,0 +1,502 @@
+//======================================================================================================================
+// File Name    : engine.c
+// Description  : Headless tetris simulation core: spawning, collision, locking, line clears, scoring and levels
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "engine.h"
+#include "pieces.h"
+
+// MACROS //
+#define LEVEL_MIN           1
+#define LEVEL_MAX           GRAV_LEVELS
+
+
+// PROTOTYPES //
+static void shuffle_bag(bag_t *B, rng_t *R);
+
+
+// DATA //
+static const int gravity[GRAV_LEVELS] = {1000000, 793000, 617800, 472730, 355200, 262000, 189680,
+                                         134730, 93880, 64150, 42980, 28220, 18150, 11440, 7060};   // (us / drop) / level
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// Zobrist key of row y holding `row`. Keys are per row contents rather than per cell so a line clear costs two keys
+// per moved row, they come from a fixed mixer (splitmix64) instead of a table, and an empty row has no key
+static inline uint64_t row_key(const int y, const row_t row)
+{
+    uint64_t z;
+
+    if (row == ROW_EMPTY)
+        return 0;
+    z = ((uint64_t)y << (8 * sizeof(row_t)) | row) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// returns 1 if there was a collision, otherwise returns 0 and updates the tetromino's coordinates
+static int collision(tetromino_t *tet, const row_t rows[PF_H + PF_FLOOR],
+                     enum directions_e dir, const int yoff, const int xoff)
+{
+    enum {
+        NO_COLLISION = 0,
+        ERR_COLLISION,
+    };
+
+    // Translation left, right, down
+    if (dir == DIR_LRD) {
+        if (!piece_fits(rows, PIECE(tet->shape, tet->rotation), tet->x + xoff, tet->y + yoff))
+            return ERR_COLLISION;
+        tet->x += xoff;
+        tet->y += yoff;
+        return NO_COLLISION;
+    }
+
+
+    // Rotation clockwise, counter-clockwise
+    if (tet->shape == O_tet)
+        return NO_COLLISION;
+
+    const kick_t *kicks = PIECE(tet->shape, tet->rotation)->kicks[dir - DIR_CW];
+    int rotation = (dir == DIR_CW) ? (tet->rotation + 1) % 4 : (tet->rotation + 3) % 4;
+    const piece_t *p = PIECE(tet->shape, rotation);
+
+    for (int i = 0; i < KICK_TESTS; i++) {
+        if (piece_fits(rows, p, tet->x + kicks[i].x, tet->y + kicks[i].y)) {
+            tet->x += kicks[i].x;
+            tet->y += kicks[i].y;
+            tet->rotation = rotation;
+            tet->bitmap = p->bitmap;
+            return NO_COLLISION;
+        }
+    }
+    return ERR_COLLISION;
+}
+
+// recompute the height and holes of a single column from the row masks
+static void scan_column(metrics_t *M, const row_t rows[PF_H + PF_FLOOR], const int x)
+{
+    const row_t bit = ROW_BIT(x);
+    int top = 0, holes = 0;
+
+    while (top < PF_H && !(rows[top] & bit))
+        top++;
+    for (int y = top + 1; y < PF_H; y++)
+        holes += !(rows[y] & bit);
+
+    M->holes += holes - M->col_holes[x];
+    M->col_holes[x] = (int8_t)holes;
+    M->heights[x] = (int8_t)(PF_H - top);
+}
+
+// max height and wells only depend on the column heights, so they are refreshed from those after every change
+static void update_summary(metrics_t *M)
+{
+    int left, right;
+
+    M->max_height = 0;
+    M->wells = 0;
+    for (int x = 0; x < PF_W; x++) {
+        if (M->heights[x] > M->max_height)
+            M->max_height = M->heights[x];
+        left = (x == 0) ? PF_H : M->heights[x-1];
+        right = (x == PF_W-1) ? PF_H : M->heights[x+1];
+        if (M->heights[x] < left && M->heights[x] < right)
+            M->wells |= (row_t)(1u << x);
+    }
+}
+
+// Copy a tetromino into the playfield once it has dropped, occupancy goes to the row masks and the shape to the colors.
+// Every column of a tetromino is a single vertical run, so it either lands on top of its column (any gap under it
+// becomes holes) or is tucked underneath it (filling holes)
+static void tet2playfield(const tetromino_t *tet, engine_t *E)
+{
+    const piece_t *p = PIECE(tet->shape, tet->rotation);
+    const row_t *m = p->rows[tet->x - TET_X_MIN];
+    metrics_t *M = &E->metrics;
+
+    for (int x = tet->x + p->box.x_min; x <= tet->x + p->box.x_max; x++) {
+        int top = PF_H - M->heights[x];     // highest occupied row before the lock
+        int first = -1, last = -1;          // highest and lowest row of this column of the tetromino
+
+        for (int r = p->box.y_min; r <= p->box.y_max; r++) {
+            if (m[r] & ROW_BIT(x)) {
+                if (first < 0)
+                    first = tet->y + r;
+                last = tet->y + r;
+            }
+        }
+        if (last < top) {
+            M->col_holes[x] = (int8_t)(M->col_holes[x] + top - last - 1);
+            M->holes += top - last - 1;
+            M->heights[x] = (int8_t)(PF_H - first);
+        } else {
+            M->col_holes[x] = (int8_t)(M->col_holes[x] - (last - first + 1));
+            M->holes -= last - first + 1;
+        }
+    }
+
+    for (int r = 0; r < 4; r++) {
+        int y = tet->y + r;
+        row_t mask = m[r];
+
+        if (!mask || y < 0 || y >= PF_H)
+            continue;
+        E->hash ^= row_key(y, E->rows[y]) ^ row_key(y, E->rows[y] | mask);
+        E->rows[y] |= mask;
+        for (int x = tet->x; x < tet->x + 4; x++) {
+            if (mask & ROW_BIT(x))
+                E->colors[y][x] = tet->shape;
+        }
+    }
+    update_summary(M);
+}
+
+// Find the full rows among the ones the falling tetromino covers, then compact everything above them in one stable
+// bottom-up pass of whole-row moves. Occupied rows are always contiguous from the floor, so the pass stops at the
+// top of the stack. Returns the number of lines cleared, `clear` records which rows, bottom first
+static int clear_lines(engine_t *E, clear_t *clear)
+{
+    const piece_t *p = PIECE(E->tetromino.shape, E->tetromino.rotation);
+    int top = E->tetromino.y + p->box.y_min;
+    int bottom = E->tetromino.y + p->box.y_max;
+    int dst, src;
+
+    clear->count = 0;
+    for (int y = (bottom < PF_H ? bottom : PF_H-1); y >= top && y >= 0; y--) {
+        if (E->rows[y] == ROW_FULL)
+            clear->rows[clear->count++] = y;
+    }
+    if (!clear->count)
+        return 0;
+
+    // each row's key is taken out where it was and put back where it lands, cleared rows are only taken out
+    dst = clear->rows[0];
+    E->hash ^= row_key(dst, ROW_FULL);
+    for (src = dst - 1; src >= PF_H - E->metrics.max_height; src--) {
+        E->hash ^= row_key(src, E->rows[src]);
+        if (E->rows[src] == ROW_FULL)
+            continue;
+        E->hash ^= row_key(dst, E->rows[src]);
+        E->rows[dst] = E->rows[src];
+        memcpy(E->colors[dst], E->colors[src], sizeof(E->colors[dst]));
+        dst--;
+    }
+    for (; dst > src; dst--) {
+        E->rows[dst] = ROW_EMPTY;
+        memset(E->colors[dst], 0, sizeof(E->colors[dst]));
+    }
+
+    // every column was occupied on every cleared row, so each one just gets shorter and keeps its holes, unless its
+    // top cell was on the highest cleared row and the holes under it are now open
+    for (int x = 0; x < PF_W; x++) {
+        if (PF_H - E->metrics.heights[x] == clear->rows[clear->count-1])
+            scan_column(&E->metrics, E->rows, x);
+        else
+            E->metrics.heights[x] = (int8_t)(E->metrics.heights[x] - clear->count);
+    }
+    update_summary(&E->metrics);
+    return clear->count;
+}
+
+// set up the next tetromino at the top of the playfield
+static void spawn_tetromino(engine_t *E)
+{
+    E->tetromino.shape = E->next_shape;
+    if (++E->bag.idx == BAG_SIZE)
+        shuffle_bag(&E->bag, &E->rng);
+    E->next_shape = E->bag.tetrominos[E->bag.idx];
+    E->tetromino.x = TETROMINO_SPAWN_X;
+    E->tetromino.y = TETROMINO_SPAWN_Y;
+    E->tetromino.rotation = 0;
+    E->tetromino.falling = true;
+    E->tetromino.bitmap = PIECE(E->tetromino.shape, 0)->bitmap;
+    E->gravity_acc = 0;
+    E->slide_ticks = 0;
+}
+
+// a player move or rotation, a successful one restarts the slide timer
+static unsigned shift(engine_t *E, enum directions_e dir, const int xoff)
+{
+    if (collision(&E->tetromino, E->rows, dir, 0, xoff))
+        return EV_NONE;
+    E->slide_ticks = 0;
+    return EV_MOVED;
+}
+
+// copy the falling tetromino to the playfield, clear lines, score, and spawn the next tetromino
+static unsigned lock_tetromino(engine_t *E)
+{
+    unsigned events = EV_LOCKED;
+    int lines_cleared;              // used to count the numbers of lines cleared from a single drop, added to `lines`
+
+    // Copy tetromino to the playfield buffer
+    E->tetromino.falling = false;
+    tet2playfield(&E->tetromino, E);
+
+    // Check for game over, a block in the buffer zone
+    if (E->metrics.max_height > PF_H - PF_BUFF_SIZE - 1)
+        E->running = false;
+
+    // Check for line clears
+    lines_cleared = clear_lines(E, &E->clear);
+    if (lines_cleared)
+        events |= EV_LINES;
+
+    // Increase score (and level) if there were line clears
+    if (lines_cleared) {
+        switch (lines_cleared) {
+            case 1:
+                E->score += 100 * E->level;
+                break;
+            case 2:
+                E->score += 300 * E->level;
+                break;
+            case 3:
+                E->score += 500 * E->level;
+                break;
+            case 4:
+                E->score += 800 * E->level;
+                break;
+            default:
+                _exit(3);   // TODO: if this ever happens, add cases for more than 4 clears
+        }
+        E->lines += lines_cleared;
+        E->level = (E->level == LEVEL_MAX) ? LEVEL_MAX : (E->lines / 10) + 1;
+        if (E->level > LEVEL_MAX)
+            E->level = LEVEL_MAX;
+    }
+
+    if (!E->running)
+        return events | EV_GAME_OVER;
+
+    spawn_tetromino(E);
+    return events;
+}
+
+
+// API //---------------------------------------------------------------------------------------------------------------
+// start a new game, the same seed always deals the same tetrominos
+void engine_init(engine_t *E, const uint64_t seed)
+{
+    memset(E, 0, sizeof(*E));
+    for (int i = 0; i < PF_H; i++)
+        E->rows[i] = ROW_EMPTY;
+    for (int i = PF_H; i < PF_H + PF_FLOOR; i++)
+        E->rows[i] = ROW_FULL;
+    rng_seed(&E->rng, seed, 0);
+    shuffle_bag(&E->bag, &E->rng);
+    E->next_shape = E->bag.tetrominos[0];
+    E->score = 0;
+    E->lines = 0;
+    E->level = LEVEL_MIN;
+    E->running = true;
+    spawn_tetromino(E);
+}
+
+// advance one fixed timestep: gravity accumulates TICK_US per tick and pulls the tetromino down a row each time a full
+// drop interval has built up, a resting tetromino locks once the slide timer runs out
+static unsigned tick(engine_t *E)
+{
+    unsigned events = EV_NONE;
+    const int g = gravity[E->level - 1];
+    int rows, drop;
+
+    E->tick++;
+    E->slide_ticks++;
+    E->gravity_acc += TICK_US;
+    if (E->gravity_acc < g)
+        return EV_NONE;
+
+    // every row that came due falls at once, as far as the landing row allows
+    rows = E->gravity_acc / g;
+    if (rows > GRAVITY_MAX_G)
+        rows = GRAVITY_MAX_G;
+    drop = engine_drop_distance(E);
+    if (rows <= drop) {
+        E->tetromino.y += rows;
+        E->gravity_acc %= g;
+        return EV_MOVED;
+    }
+
+    E->tetromino.y += drop;
+    E->gravity_acc = g;             // stays due, so it falls on the next tick if it is moved off the ledge
+    events = (drop ? EV_MOVED : EV_NONE) | EV_GROUNDED;
+    if (E->level == GRAV_LEVELS - 1 || E->slide_ticks >= LOCK_TICKS)
+        events |= lock_tetromino(E);
+    return events;
+}
+
+// advance the game by a single input, returns a bitmask of `engine_events_e`
+unsigned engine_step(engine_t *E, input_t in)
+{
+    tetromino_t *tet = &E->tetromino;
+
+    if (!E->running)
+        return EV_GAME_OVER;
+
+    switch (in) {
+        case IN_LEFT:
+            return shift(E, DIR_LRD, -1);
+
+        case IN_RIGHT:
+            return shift(E, DIR_LRD, 1);
+
+        case IN_CW:
+            return shift(E, DIR_CW, 0);
+
+        case IN_CCW:
+            return shift(E, DIR_CCW, 0);
+
+        case IN_SOFT_DROP:
+            if (collision(tet, E->rows, DIR_LRD, 1, 0))
+                return EV_GROUNDED | lock_tetromino(E);
+            return EV_MOVED;
+
+        case IN_HARD_DROP:
+            tet->y += engine_drop_distance(E);
+            return EV_GROUNDED | lock_tetromino(E);
+
+        case IN_TICK:
+            return tick(E);
+
+        case IN_LEVEL_DOWN:
+            if (E->level > LEVEL_MIN)
+                E->level--;
+            return EV_NONE;
+
+        case IN_LEVEL_UP:
+            if (E->level < LEVEL_MAX)
+                E->level++;
+            return EV_NONE;
+
+        case IN_QUIT:
+            E->running = false;
+            return EV_GAME_OVER;
+
+        case IN_NONE:
+        default:
+            return EV_NONE;
+    }
+}
+
+// rows the falling tetromino can drop before it lands. While every column of the tetromino is above its stack this
+// is the smallest gap between the two, read from the column heights. A tetromino tucked under an overhang has no such
+// shortcut and is walked down the row masks instead
+int engine_drop_distance(const engine_t *E)
+{
+    const tetromino_t *tet = &E->tetromino;
+    const piece_t *p = PIECE(tet->shape, tet->rotation);
+    int drop = PF_H, gap, y;
+
+    for (int i = p->box.x_min; i <= p->box.x_max; i++) {
+        gap = (PF_H - E->metrics.heights[tet->x + i]) - (tet->y + p->col_bottom[i]) - 1;
+        if (gap < 0) {
+            for (y = tet->y; piece_fits(E->rows, p, tet->x, y + 1); y++)
+                ;
+            return y - tet->y;
+        }
+        if (gap < drop)
+            drop = gap;
+    }
+    return drop;
+}
+
+// number of ticks, at least 1, until a tick could change anything the player sees. Ticks before that only move the
+// counters, so a front end may sleep through them as long as it still runs every one of them in order
+int engine_idle_ticks(const engine_t *E)
+{
+    const int g = gravity[E->level - 1];
+    tetromino_t tmp = E->tetromino;
+
+    if (!E->running || E->level == GRAV_LEVELS - 1)
+        return 1;
+    if (E->gravity_acc < g)
+        return (g - E->gravity_acc + TICK_US - 1) / TICK_US;
+    if (!collision(&tmp, E->rows, DIR_LRD, 1, 0) || E->slide_ticks >= LOCK_TICKS - 1)
+        return 1;
+    return LOCK_TICKS - E->slide_ticks;
+}
+
+// recompute `E->hash` from scratch, it always equals the incrementally maintained value
+uint64_t engine_hash(const engine_t *E)
+{
+    uint64_t hash = 0;
+
+    for (int y = 0; y < PF_H; y++)
+        hash ^= row_key(y, E->rows[y]);
+    return hash;
+}
+
+// recompute the metrics and hash from the row masks, after the playfield was written directly instead of played
+void engine_rebuild(engine_t *E)
+{
+    memset(&E->metrics, 0, sizeof(E->metrics));
+    for (int x = 0; x < PF_W; x++)
+        scan_column(&E->metrics, E->rows, x);
+    update_summary(&E->metrics);
+    E->hash = engine_hash(E);
+}
+
+// write the next `n` shapes to be spawned into `out`, starting with `next_shape`, without advancing the game
+int engine_preview(const engine_t *E, shapes_t *out, const int n)
+{
+    bag_t bag = E->bag;
+    rng_t rng = E->rng;
+
+    if (n <= 0)
+        return 0;
+    out[0] = E->next_shape;
+    for (int i = 1; i < n; i++) {
+        if (++bag.idx == BAG_SIZE)
+            shuffle_bag(&bag, &rng);
+        out[i] = bag.tetrominos[bag.idx];
+    }
+    return n;
+}
+
+// Each board size is its own build, `tool` for the w x h board is <tool>-<w>x<h> next to this executable.
+// Run it with the same arguments, returns only if it could not be run
+void engine_exec_board(const char *tool, const int w, const int h, char *argv[])
+{
+    char self[PATH_MAX], path[PATH_MAX + 64];
+    ssize_t n;
+
+    if ((n = readlink("/proc/self/exe", self, sizeof(self) - 1)) < 0)
+        return;
+    self[n] = '\0';
+    snprintf(path, sizeof(path), "%s/%s-%dx%d", dirname(self), tool, w, h);
+    execv(path, argv);
+}
+
+
+// HELPER FUNCTIONS //
+static void shuffle_bag(bag_t *B, rng_t *R)
+{
+    int i, j;
+    shapes_t tmp;
+
+    // just in case a buffer overflows :)
+    for (i = 0; i < BAG_SIZE; i++)
+        B->tetrominos[i] = I_tet+i;
+
+    for (i = BAG_SIZE-1; i > 0; i--) {
+        j = (int)rng_below(R, (uint32_t)(i+1));
+        tmp = B->tetrominos[j];
+        B->tetrominos[j] = B->tetrominos[i];
+        B->tetrominos[i] = tmp;
+    }
+
+    B->idx = 0;
+}
@@ -0,0 +1,173 @@
+//======================================================================================================================
+// File Name    : engine.h
+// Description  : Headless, re-entrant tetris simulation core. Holds no globals and never touches ncurses, so any
+//                number of games can be stepped side by side without a terminal
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_ENGINE_H
+#define TETRIS_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "rng.h"
+
+// MACROS //
+#define RULESET_VERSION     2           // bump whenever the same inputs could give a different game
+#define BAG_SIZE            7
+#define GRAV_LEVELS         15
+#define PF_W                BOARD_W
+#define PF_H                (PF_BUFF_SIZE+1+BOARD_H)
+#define PF_BUFF_SIZE        19
+#define PLAYFIELD_HEIGHT    (PF_H-PF_BUFF_SIZE)
+#define PF_FLOOR            4           // solid rows under the playfield so a bitmap can hang past the last row
+#define TETROMINO_SPAWN_X   ((PF_W-4)/2)
+#define TICK_US             16667       // length of one fixed simulation tick (60 Hz)
+#define LOCK_TICKS          30          // ticks a resting tetromino may slide before it locks (0.5s)
+#define GRAVITY_MAX_G       20          // most rows gravity can pull a tetromino in a single tick
+#define TETROMINO_SPAWN_Y   (PF_BUFF_SIZE-2)    // examine why `update_playfield()` uses `PF_BUFF_SIZE`, not y
+
+// BOARD SIZE
+// Columns and visible rows of the board, fixed when the engine is compiled so every loop bound, shift and mask below
+// is a constant and the kernels are specialised for the width. Each size is its own build (`-DBOARD_W=4`, see
+// CMakeLists.txt), and games, replays and streams of one size are not read by a build of another
+#ifndef BOARD_W
+#define BOARD_W             10
+#endif
+#ifndef BOARD_H
+#define BOARD_H             20
+#endif
+#if BOARD_W < 4 || BOARD_H < 4
+#error "a board must be at least 4x4"
+#endif
+_Static_assert(PF_H <= INT8_MAX, "column heights and holes must fit in the int8_t fields of metrics_t");
+
+// BITBOARD
+// Each playfield row is a `row_t` mask, the narrowest unsigned type with room for 3 wall bits on the left, PF_W
+// columns (column 0 is the highest of those bits) and 3 wall bits on the right, the unused high bits are walls too.
+// A 4 wide bitmap row can then be shifted anywhere from x = -3 to x = PF_W-1 without leaving the mask, and the walls
+// make out of bounds cells collide like any other occupied cell
+#define ROW_PAD             3
+#define ROW_BITS            (PF_W + 2*ROW_PAD)
+#define ROW_FULL            ((row_t)~(row_t)0)
+#define ROW_EMPTY           (ROW_FULL & ~(((1u << PF_W) - 1) << ROW_PAD))
+#define ROW_BIT(x)          (1u << (ROW_PAD + PF_W - 1 - (x)))
+#define TET_X_MIN           (-ROW_PAD)
+#define TET_X_MAX           (PF_W - 1)
+#define TET_ROW(bm, r, x)   ((row_t)((((bm) >> (12 - 4*(r))) & 0xFu) << (ROW_PAD + PF_W - 4 - (x))))
+
+
+// TYPEDEFS & ENUMS //
+#if ROW_BITS <= 16
+typedef uint16_t row_t;
+#elif ROW_BITS <= 32
+typedef uint32_t row_t;
+#else
+#error "BOARD_W is too wide for a 32 bit row"
+#endif
+
+enum directions_e {
+    DIR_LRD = 0,
+    DIR_CW,
+    DIR_CCW,
+};
+
+typedef enum {
+    I_tet = 1,
+    O_tet,
+    T_tet,
+    S_tet,
+    Z_tet,
+    J_tet,
+    L_tet,
+} shapes_t;
+
+typedef struct {
+    shapes_t shape;
+    int x;
+    int y;
+    int rotation;
+    uint16_t bitmap;
+    bool falling;
+} tetromino_t;
+
+typedef struct {
+    shapes_t tetrominos[BAG_SIZE];
+    int idx;
+} bag_t;
+
+// inputs accepted by `engine_step()`, one per call
+typedef enum {
+    IN_NONE = 0,
+    IN_LEFT,
+    IN_RIGHT,
+    IN_SOFT_DROP,       // move down one row, locks if the piece is already resting
+    IN_CW,
+    IN_CCW,
+    IN_HARD_DROP,
+    IN_TICK,            // advance one fixed timestep of TICK_US: gravity and the slide timer
+    IN_LEVEL_DOWN,
+    IN_LEVEL_UP,
+    IN_QUIT,
+} input_t;
+
+// bitmask returned by `engine_step()` describing what happened
+enum engine_events_e {
+    EV_NONE         = 0,
+    EV_MOVED        = 1u << 0,  // the piece translated or rotated
+    EV_GROUNDED     = 1u << 1,  // the piece tried to move down and could not
+    EV_LOCKED       = 1u << 2,  // the piece was copied to the playfield and the next one spawned
+    EV_LINES        = 1u << 3,  // the lock cleared at least one line
+    EV_GAME_OVER    = 1u << 4,  // the game has ended, further steps are ignored
+};
+
+// lines removed by a single lock
+typedef struct {
+    int count;
+    int rows[4];                        // playfield rows before the clear, bottom first
+} clear_t;
+
+// shape of the stack, kept up to date by every lock and line clear
+typedef struct {
+    int8_t heights[PF_W];               // rows from the floor to the highest occupied cell of each column
+    int8_t col_holes[PF_W];             // empty cells under the highest occupied cell of each column
+    int8_t max_height;
+    int16_t holes;                      // sum of `col_holes`
+    row_t wells;                        // bit x is set when column x is lower than both neighbours, walls count as full
+} metrics_t;
+
+// all state of a single game
+typedef struct {
+    row_t rows[PF_H + PF_FLOOR];        // occupancy, see BITBOARD
+    uint8_t colors[PF_H][PF_W];         // shape of each occupied cell, 0 when empty
+    tetromino_t tetromino;
+    shapes_t next_shape;
+    bag_t bag;
+    rng_t rng;                          // drives the bag and nothing else, so a seed fixes the piece sequence
+    int score;
+    int lines;
+    int level;
+    bool running;
+    clear_t clear;                      // lines removed by the last lock, valid when it reported EV_LINES
+    metrics_t metrics;
+    uint64_t hash;                      // Zobrist hash of the occupied cells, see `engine_hash()`
+    uint64_t tick;                      // fixed timesteps run so far
+    int gravity_acc;                    // microseconds of gravity built up towards the next drop
+    int slide_ticks;                    // ticks since the last successful move, the tetromino locks at LOCK_TICKS
+} engine_t;
+
+
+// PROTOTYPES //
+void engine_init(engine_t *E, uint64_t seed);
+int engine_preview(const engine_t *E, shapes_t *out, int n);
+unsigned engine_step(engine_t *E, input_t in);
+int engine_idle_ticks(const engine_t *E);
+int engine_drop_distance(const engine_t *E);
+uint64_t engine_hash(const engine_t *E);
+void engine_rebuild(engine_t *E);
+void engine_exec_board(const char *tool, int w, int h, char *argv[]);
+
+#endif //TETRIS_ENGINE_H
@@ -0,0 +1,210 @@
+//======================================================================================================================
+// File Name    : eval.c
+// Description  : Board evaluation kernels. Every term is counted a row at a time from the top: `acc` is the OR of the
+//                rows seen so far, so a column is covered from its highest cell down and
+//                  height      += popcount(acc)                       on the playfield columns
+//                  holes       += popcount(acc & ~row)
+//                  bumpiness   += popcount(acc ^ acc >> 1)            on neighbouring column pairs
+//                  wells       += popcount(~acc & acc << 1 & acc >> 1)
+//                The wall bits start out set, so the walls count as infinitely high columns for the wells
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <string.h>
+#include "eval.h"
+
+// the vector kernels work on 16 bit lanes, boards with wider rows are scored by the scalar one
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && ROW_BITS <= 16
+#define EVAL_X86
+#include <immintrin.h>
+#endif
+
+// MACROS //
+#define FIELD               ((row_t)~ROW_EMPTY)                         // playfield column bits
+#define PAIRS               ((row_t)(FIELD & (FIELD >> 1)))             // column bits whose right neighbour is a column
+
+
+// HELPER FUNCTIONS //
+static void score_scalar(const eval_batch_t *B, const eval_weights_t *W, int32_t out[EVAL_LANES])
+{
+    for (int i = 0; i < EVAL_LANES; i++) {
+        int height = 0, holes = 0, bumpiness = 0, wells = 0;
+        row_t acc = ROW_EMPTY;
+
+        for (int y = B->top; y < PF_H; y++) {
+            const row_t row = B->rows[y][i];
+            acc |= row;
+            height += __builtin_popcount(acc & FIELD);
+            holes += __builtin_popcount(acc & ~row & FIELD);
+            bumpiness += __builtin_popcount((acc ^ acc >> 1) & PAIRS);
+            wells += __builtin_popcount(~acc & acc << 1 & acc >> 1 & FIELD);
+        }
+        out[i] = W->height * height + W->holes * holes + W->bumpiness * bumpiness + W->wells * wells +
+                 W->lines * B->lines[i];
+    }
+}
+
+#ifdef EVAL_X86
+// popcount of each 16 bit lane: a nibble lookup per byte, then the two bytes of a lane are added
+__attribute__((target("sse4.1")))
+static inline __m128i popcount_sse4(const __m128i v)
+{
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low = _mm_set1_epi8(0x0F);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(lut, _mm_and_si128(v, low)),
+                                 _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low)));
+    return _mm_maddubs_epi16(bytes, _mm_set1_epi8(1));
+}
+
+// weighted sum of 8 lanes of 16 bit counts, widened to 32 bits
+__attribute__((target("sse4.1")))
+static inline __m128i weigh_sse4(const __m128i count, const int32_t w, const int half)
+{
+    const __m128i wide = _mm_cvtepi16_epi32(half ? _mm_unpackhi_epi64(count, count) : count);
+    return _mm_mullo_epi32(wide, _mm_set1_epi32(w));
+}
+
+__attribute__((target("sse4.1")))
+static void score_sse4(const eval_batch_t *B, const eval_weights_t *W, int32_t out[EVAL_LANES])
+{
+    const __m128i field = _mm_set1_epi16((short)FIELD), pairs = _mm_set1_epi16((short)PAIRS);
+
+    for (int i = 0; i < EVAL_LANES; i += 8) {
+        __m128i acc = _mm_set1_epi16((short)ROW_EMPTY);
+        __m128i height = _mm_setzero_si128(), holes = height, bumpiness = height, wells = height;
+
+        for (int y = B->top; y < PF_H; y++) {
+            const __m128i row = _mm_load_si128((const __m128i *)&B->rows[y][i]);
+            acc = _mm_or_si128(acc, row);
+            height = _mm_add_epi16(height, popcount_sse4(_mm_and_si128(acc, field)));
+            holes = _mm_add_epi16(holes, popcount_sse4(_mm_and_si128(_mm_andnot_si128(row, acc), field)));
+            bumpiness = _mm_add_epi16(bumpiness, popcount_sse4(
+                    _mm_and_si128(_mm_xor_si128(acc, _mm_srli_epi16(acc, 1)), pairs)));
+            wells = _mm_add_epi16(wells, popcount_sse4(_mm_and_si128(_mm_andnot_si128(acc,
+                    _mm_and_si128(_mm_slli_epi16(acc, 1), _mm_srli_epi16(acc, 1))), field)));
+        }
+
+        const __m128i lines = _mm_loadu_si128((const __m128i *)&B->lines[i]);
+        for (int half = 0; half < 2; half++) {
+            __m128i sum = weigh_sse4(height, W->height, half);
+            sum = _mm_add_epi32(sum, weigh_sse4(holes, W->holes, half));
+            sum = _mm_add_epi32(sum, weigh_sse4(bumpiness, W->bumpiness, half));
+            sum = _mm_add_epi32(sum, weigh_sse4(wells, W->wells, half));
+            sum = _mm_add_epi32(sum, weigh_sse4(lines, W->lines, half));
+            _mm_storeu_si128((__m128i *)&out[i + 4*half], sum);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i popcount_avx2(const __m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+    return _mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i weigh_avx2(const __m256i count, const int32_t w, const int half)
+{
+    const __m256i wide = _mm256_cvtepi16_epi32(half ? _mm256_extracti128_si256(count, 1)
+                                                    : _mm256_castsi256_si128(count));
+    return _mm256_mullo_epi32(wide, _mm256_set1_epi32(w));
+}
+
+__attribute__((target("avx2")))
+static void score_avx2(const eval_batch_t *B, const eval_weights_t *W, int32_t out[EVAL_LANES])
+{
+    const __m256i field = _mm256_set1_epi16((short)FIELD), pairs = _mm256_set1_epi16((short)PAIRS);
+    __m256i acc = _mm256_set1_epi16((short)ROW_EMPTY);
+    __m256i height = _mm256_setzero_si256(), holes = height, bumpiness = height, wells = height;
+
+    for (int y = B->top; y < PF_H; y++) {
+        const __m256i row = _mm256_load_si256((const __m256i *)B->rows[y]);
+        acc = _mm256_or_si256(acc, row);
+        height = _mm256_add_epi16(height, popcount_avx2(_mm256_and_si256(acc, field)));
+        holes = _mm256_add_epi16(holes, popcount_avx2(_mm256_and_si256(_mm256_andnot_si256(row, acc), field)));
+        bumpiness = _mm256_add_epi16(bumpiness, popcount_avx2(
+                _mm256_and_si256(_mm256_xor_si256(acc, _mm256_srli_epi16(acc, 1)), pairs)));
+        wells = _mm256_add_epi16(wells, popcount_avx2(_mm256_and_si256(_mm256_andnot_si256(acc,
+                _mm256_and_si256(_mm256_slli_epi16(acc, 1), _mm256_srli_epi16(acc, 1))), field)));
+    }
+
+    const __m256i lines = _mm256_loadu_si256((const __m256i *)B->lines);
+    for (int half = 0; half < 2; half++) {
+        __m256i sum = weigh_avx2(height, W->height, half);
+        sum = _mm256_add_epi32(sum, weigh_avx2(holes, W->holes, half));
+        sum = _mm256_add_epi32(sum, weigh_avx2(bumpiness, W->bumpiness, half));
+        sum = _mm256_add_epi32(sum, weigh_avx2(wells, W->wells, half));
+        sum = _mm256_add_epi32(sum, weigh_avx2(lines, W->lines, half));
+        _mm256_storeu_si256((__m256i *)&out[8*half], sum);
+    }
+}
+#endif
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// empty the batch, unused lanes hold empty boards
+void eval_reset(eval_batch_t *B)
+{
+    for (int y = 0; y < PF_H; y++)
+        for (int i = 0; i < EVAL_LANES; i++)
+            B->rows[y][i] = ROW_EMPTY;
+    memset(B->lines, 0, sizeof(B->lines));
+    B->count = 0;
+    B->top = PF_H;
+}
+
+// copy the playfield of `E`, which cleared `lines` with its last lock, into the next lane.
+// returns the lane, -1 when the batch is full
+int eval_add(eval_batch_t *B, const engine_t *E, const int lines)
+{
+    const int top = PF_H - E->metrics.max_height, i = B->count;
+
+    if (i == EVAL_LANES)
+        return -1;
+    for (int y = top; y < PF_H; y++)
+        B->rows[y][i] = E->rows[y];
+    B->lines[i] = (int16_t)lines;
+    if (top < B->top)
+        B->top = top;
+    return B->count++;
+}
+
+// score every lane of `B`, higher is better with the usual negative weights for height, holes, bumpiness and wells
+void eval_score(const eval_batch_t *B, const eval_weights_t *W, int32_t out[EVAL_LANES], eval_isa_e isa)
+{
+    if (isa == EVAL_AUTO)
+        isa = eval_best_isa();
+
+    switch (isa) {
+#ifdef EVAL_X86
+        case EVAL_AVX2:
+            score_avx2(B, W, out);
+            return;
+        case EVAL_SSE4:
+            score_sse4(B, W, out);
+            return;
+#endif
+        default:
+            score_scalar(B, W, out);
+            return;
+    }
+}
+
+eval_isa_e eval_best_isa(void)
+{
+#ifdef EVAL_X86
+    if (__builtin_cpu_supports("avx2"))
+        return EVAL_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return EVAL_SSE4;
+#endif
+    return EVAL_SCALAR;
+}
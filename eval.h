@@ -0,0 +1,53 @@
+//======================================================================================================================
+// File Name    : eval.h
+// Description  : Batched board evaluator: candidate boards are stored row by row side by side (structure of arrays), so
+//                row y of every board is one vector and up to EVAL_LANES boards are scored together
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_EVAL_H
+#define TETRIS_EVAL_H
+
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+#define EVAL_LANES          16
+
+
+// TYPEDEFS & ENUMS //
+// kernels, every one gives exactly the same scores
+typedef enum {
+    EVAL_AUTO = 0,                      // the fastest one this CPU supports
+    EVAL_SCALAR,
+    EVAL_SSE4,
+    EVAL_AVX2,
+} eval_isa_e;
+
+// each term is a count over the whole board, the score is the weighted sum
+typedef struct {
+    int32_t height;                     // sum of the column heights
+    int32_t holes;                      // empty cells under the top of their column
+    int32_t bumpiness;                  // sum of the height differences of neighbouring columns
+    int32_t wells;                      // empty cells above the top of their column with both neighbours higher
+    int32_t lines;                      // lines cleared by the placement
+} eval_weights_t;
+
+typedef struct {
+    _Alignas(32) row_t rows[PF_H][EVAL_LANES];      // row y of board i is rows[y][i], see BITBOARD
+    int16_t lines[EVAL_LANES];
+    int count;
+    int top;                            // highest occupied row over all boards, the rows above are empty everywhere
+} eval_batch_t;
+
+
+// PROTOTYPES //
+void eval_reset(eval_batch_t *B);
+int eval_add(eval_batch_t *B, const engine_t *E, int lines);
+void eval_score(const eval_batch_t *B, const eval_weights_t *W, int32_t out[EVAL_LANES], eval_isa_e isa);
+eval_isa_e eval_best_isa(void);
+
+#endif //TETRIS_EVAL_H
@@ -0,0 +1,237 @@
+//======================================================================================================================
+// File Name    : input.c
+// Description  : Raw terminal input. Plain bytes and the kitty keyboard protocol are both decoded: a terminal that
+//                speaks the protocol reports releases, any other one only repeats, so a key is held for as long as
+//                its repeats keep coming
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "input.h"
+
+// MACROS //
+#define ESC                 0x1b
+#define CSI                 "\x1b["
+#define KITTY_FLAGS         "11"        // disambiguate keys, report event types, report every key as an escape code
+#define MAX_PARAMS          3
+
+
+// DATA //
+static struct termios saved;                // terminal settings to restore on close
+static bool raw;                            // `saved` is valid and the terminal was switched to raw input
+static bool kitty;                          // a kitty protocol event arrived, releases will be reported
+
+// bytes read but not decoded yet, an escape sequence can be cut in two by the end of a read
+static struct {
+    unsigned char buf[256];
+    int len;
+} pending;
+
+static struct {
+    bool down;
+    bool repeated;                          // a repeat came since the press, the terminal's initial delay is over
+    int64_t seen_ns;                        // last press or repeat
+} keys[INPUT_KEYS];
+
+static int64_t first_gap_ns = INPUT_REPEAT_GAP_NS;  // how long a plain key is held before its first repeat
+
+static int64_t drained_ns;                  // time of the last `input_drain()`
+
+
+// HELPER FUNCTIONS //
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// the longest a plain key may go unseen and still be held: the terminal's initial delay until its first repeat, then
+// INPUT_REPEAT_GAP_NS
+static int64_t hold_gap(const int key)
+{
+    return keys[key].repeated ? INPUT_REPEAT_GAP_NS : first_gap_ns;
+}
+
+// a plain byte is a repeat when its key is still held
+static key_type_t legacy_type(const int key, const int64_t now)
+{
+    key_type_t type = keys[key].down && now - keys[key].seen_ns < hold_gap(key) ? KEY_REPEAT : KEY_PRESS;
+
+    keys[key].down = true;
+    keys[key].repeated = type == KEY_REPEAT;
+    keys[key].seen_ns = now;
+    return type;
+}
+
+// Decode the escape sequence at `s`, `n` bytes long at most. Returns the bytes it takes, 0 when it is cut off by the
+// end of the buffer. `E->key` is left at -1 for sequences that are not keys, and `E->type` at 0 unless the sequence
+// came from the kitty protocol, the only one to tell presses, repeats and releases apart
+static int decode_escape(const unsigned char *s, const int n, key_event_t *E)
+{
+    int p[MAX_PARAMS][2] = {{-1, -1}, {-1, -1}, {-1, -1}};  // parameter and sub-parameter after ':', -1 if absent
+    int param = 0, sub = 0, i = 2;
+
+    E->key = -1;
+    E->type = 0;
+    if (n < 2)
+        return n == 1 ? 1 : 0;              // a lone ESC is the escape key, not a game key
+    if (s[1] == 'O') {                      // SS3 arrows, sent in application cursor mode
+        if (n < 3)
+            return 0;
+        if (s[2] >= 'A' && s[2] <= 'D')
+            E->key = ARROW_UP + (s[2] - 'A');
+        return 3;
+    }
+    if (s[1] != '[')
+        return 2;                           // Alt+key, not a game key
+
+    for (; i < n && (s[i] < 0x40 || s[i] > 0x7e); i++) {
+        if (s[i] == ';' && param < MAX_PARAMS - 1) {
+            param++;
+            sub = 0;
+        } else if (s[i] == ':') {
+            sub++;
+        } else if (s[i] >= '0' && s[i] <= '9' && sub < 2) {
+            p[param][sub] = (p[param][sub] < 0 ? 0 : p[param][sub] * 10) + (s[i] - '0');
+        }
+    }
+    if (i == n)
+        return 0;
+
+    // CSI code ; modifiers : event u, or CSI 1 ; modifiers : event A to D for the arrows
+    if (s[i] == 'u' && p[0][0] >= 0 && p[0][0] < ARROW_UP)
+        E->key = p[0][0];
+    else if (s[i] >= 'A' && s[i] <= 'D')
+        E->key = ARROW_UP + (s[i] - 'A');
+    if (E->key >= 'a' && E->key <= 'z' && p[1][0] > 0 && ((p[1][0] - 1) & 4))
+        E->key &= 0x1f;                     // Ctrl
+    if (s[i] == 'u' || p[1][1] >= 0)
+        E->type = p[1][1] >= KEY_PRESS && p[1][1] <= KEY_RELEASE ? (key_type_t)p[1][1] : KEY_PRESS;
+    return i + 1;
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// Read keys one byte at a time, without echo or waiting for a line, and ask for key releases where they are reported.
+// Ctrl-C, Ctrl-Z, Ctrl-S and Ctrl-Q arrive as keys too rather than as signals or flow control, so the caller can
+// quit cleanly and restore the terminal. Without release events a pressed key is held until its repeats stop, and
+// `repeat_delay_ms` is the terminal's delay before the first one. It is 0 when unknown, a key then counts as released
+// until it repeats, so auto-shift waits for the terminal. Otherwise a tap counts as held for that long
+void input_open(const int repeat_delay_ms)
+{
+    struct termios t;
+
+    first_gap_ns = INPUT_REPEAT_GAP_NS + (repeat_delay_ms > 0 ? (int64_t)repeat_delay_ms * 1000000 : 0);
+
+    if (tcgetattr(STDIN_FILENO, &saved) == 0) {
+        t = saved;
+        t.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG);
+        t.c_iflag &= ~(tcflag_t)IXON;
+        t.c_cc[VMIN] = 0;                   // read() returns at once, `tetris_run()` waits in poll() instead
+        t.c_cc[VTIME] = 0;
+        raw = tcsetattr(STDIN_FILENO, TCSANOW, &t) == 0;
+    }
+    (void) !write(STDOUT_FILENO, CSI ">" KITTY_FLAGS "u", sizeof(CSI ">" KITTY_FLAGS "u") - 1);
+}
+
+void input_close(void)
+{
+    (void) !write(STDOUT_FILENO, CSI "<u", sizeof(CSI "<u") - 1);
+    if (raw)
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    raw = false;
+}
+
+// Read every byte the terminal has pending and decode up to `max` key events into `out`, all stamped with the time
+// of the read. Returns the number of events
+int input_drain(key_event_t *out, const int max)
+{
+    int64_t now = now_ns();
+    ssize_t n;
+    int count = 0, i = 0, used;
+
+    while (pending.len < (int)sizeof(pending.buf)) {
+        n = read(STDIN_FILENO, pending.buf + pending.len, sizeof(pending.buf) - (size_t)pending.len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        pending.len += (int)n;
+    }
+    drained_ns = now;
+
+    while (i < pending.len && count < max) {
+        key_event_t *E = &out[count];
+
+        if (pending.buf[i] != ESC) {
+            E->key = pending.buf[i++];
+            E->type = kitty ? KEY_PRESS : legacy_type(E->key, now);
+        } else {
+            // a sequence cut off by the end of a full buffer can never complete, drop it
+            used = decode_escape(pending.buf + i, pending.len - i, E);
+            if (!used && pending.len == (int)sizeof(pending.buf))
+                used = pending.len - i;
+            if (!used)
+                break;
+            i += used;
+            if (E->key < 0)
+                continue;
+            if (E->type && !kitty) {
+                kitty = true;
+                memset(keys, 0, sizeof(keys));  // forget the keys guessed held from plain bytes
+            }
+            if (E->type) {
+                keys[E->key].down = E->type != KEY_RELEASE;
+                keys[E->key].seen_ns = now;
+            } else {
+                E->type = legacy_type(E->key, now);
+            }
+        }
+        E->ns = now;
+        count++;
+    }
+    memmove(pending.buf, pending.buf + i, (size_t)(pending.len - i));
+    pending.len -= i;
+    return count;
+}
+
+// true while `key` is held down, as of the last `input_drain()`
+bool input_held(const int key)
+{
+    if (kitty)
+        return keys[key].down;
+    return keys[key].down && drained_ns - keys[key].seen_ns < hold_gap(key);
+}
+
+// start auto-shifting `dir` while `key` stays held, the caller moves the piece once for the press itself
+void das_press(das_t *D, const input_t dir, const int key)
+{
+    D->dir = dir;
+    D->key = key;
+    D->charge = 0;
+}
+
+// advance one tick, returns how many times to repeat `D->dir` on it
+int das_tick(das_t *D)
+{
+    if (D->dir == IN_NONE)
+        return 0;
+    if (!input_held(D->key)) {
+        D->dir = IN_NONE;
+        return 0;
+    }
+    if (++D->charge < D->das)
+        return 0;
+    if (D->arr <= 0)
+        return PF_W;                        // to the wall, the caller stops once the piece no longer moves
+    return (D->charge - D->das) % D->arr == 0;
+}
@@ -0,0 +1,66 @@
+//======================================================================================================================
+// File Name    : input.h
+// Description  : Raw terminal input: every pending byte is read at once and decoded into timestamped key events, and
+//                held keys repeat on the game's own delayed auto-shift (DAS) and auto-repeat rate (ARR)
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_INPUT_H
+#define TETRIS_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+#define INPUT_MAX_EVENTS    64          // events returned by one `input_drain()`, the rest wait for the next call
+#define INPUT_REPEAT_GAP_NS 60000000    // without release events a key is held while repeats come closer than this,
+                                        // and until its first repeat for the delay given to `input_open()`
+#define DAS_TICKS           10          // default delay before a held direction repeats (167ms)
+#define ARR_TICKS           2           // default ticks between repeats after that (33ms)
+
+
+// TYPEDEFS & ENUMS //
+// keys that are not characters, after the byte values
+enum input_keys_e {
+    ARROW_UP = 0x100,
+    ARROW_DOWN,
+    ARROW_RIGHT,
+    ARROW_LEFT,
+    INPUT_KEYS,
+};
+
+typedef enum {
+    KEY_PRESS = 1,
+    KEY_REPEAT,                         // the terminal repeating a held key
+    KEY_RELEASE,                        // only sent by terminals that speak the kitty keyboard protocol
+} key_type_t;
+
+typedef struct {
+    int key;                            // byte value or ARROW_*, Ctrl+letter is its control character
+    key_type_t type;
+    int64_t ns;                         // CLOCK_MONOTONIC time the bytes were read
+} key_event_t;
+
+// auto-shift of a held direction, advanced once per tick
+typedef struct {
+    int das;                            // ticks the direction is held before it repeats
+    int arr;                            // ticks between repeats after that, 0 slides to the wall at once
+    input_t dir;                        // IN_LEFT or IN_RIGHT being held, IN_NONE when there is none
+    int key;                            // key holding it
+    int charge;                         // ticks held so far
+} das_t;
+
+
+// PROTOTYPES //
+void input_open(int repeat_delay_ms);
+void input_close(void);
+int input_drain(key_event_t *out, int max);
+bool input_held(int key);
+void das_press(das_t *D, input_t dir, int key);
+int das_tick(das_t *D);
+
+#endif //TETRIS_INPUT_H
@@ -1,11 +1,80 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "prof.h"
 #include "tetris.h"
 
-int main()
+int main(int argc, char *argv[])
 {
-    srand(0);
+    int opt;
+    const char *profile = NULL;
+    FILE *fp;
+
+    tetris.options.seed = (unsigned)time(NULL);
+    while ((opt = getopt(argc, argv, "s:r:S:C:P:R:D:A:K:")) != -1) {
+        switch (opt) {
+            case 's':
+                tetris.options.seed = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                tetris.options.record = optarg;
+                break;
+            case 'S':
+                tetris.options.stream = optarg;
+                break;
+            case 'C':
+                tetris.options.checkpoint = optarg;
+                break;
+            case 'R':
+                if (!(tetris.options.renderer = render_find(optarg))) {
+                    fprintf(stderr, "%s: no renderer '%s', try curses or ansi\n", argv[0], optarg);
+                    return 1;
+                }
+                break;
+            case 'D':
+                tetris.options.das = atoi(optarg);
+                break;
+            case 'A':
+                tetris.options.arr = atoi(optarg);
+                break;
+            case 'K':
+                tetris.options.repeat_delay = atoi(optarg);
+                break;
+            case 'P':
+                profile = optarg;
+                prof_toggle();
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s seed] [-r replay-file] [-S stream-file] [-C checkpoint-file]"
+                        " [-P profile-file]\n       [-R curses|ansi] [-D das-ticks] [-A arr-ticks]"
+                        " [-K repeat-delay-ms]\n"
+                        "  -D and -A time a held direction in the game, but without key release events (the kitty\n"
+                        "  keyboard protocol) a terminal only shows a key is held once it repeats it. There\n"
+                        "  auto-shift starts at the terminal's first repeat, unless -K gives the terminal's repeat\n"
+                        "  delay: a key then counts as held until that long without a repeat, so a tap shifts too\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    // a replay is re-simulated from the seed, a resumed game did not start from it
+    if (tetris.options.record && tetris.options.checkpoint) {
+        fprintf(stderr, "%s: a checkpointed game cannot be recorded\n", argv[0]);
+        return 1;
+    }
 
     tetris.init();
     tetris.run();
     tetris.close();
+
+    // the profiler can be toggled in game, so the dump covers the samples since it was last turned on
+    if (profile) {
+        if (!(fp = fopen(profile, "w"))) {
+            perror(profile);
+            return 1;
+        }
+        prof_dump(fp);
+        fclose(fp);
+    }
 }
@@ -0,0 +1,203 @@
+//======================================================================================================================
+// File Name    : movegen.c
+// Description  : Breadth first search over (rotation, x, y) from the falling tetromino, with the same transitions
+//                `engine_step()` allows. Gravity and the lock timer are ignored, the player is assumed fast enough.
+//                States are handled a vertical run at a time: soft drops never branch, so a queued state stands for
+//                itself and every free cell under it, and the other moves are applied to the whole run with 64 bit
+//                operations on one word per rotation and x where bit y is row y
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include "movegen.h"
+
+// MACROS //
+#define STATE(r, x, y)      ((uint16_t)((((r) * TET_X_COUNT) + (x) - TET_X_MIN) * MOVEGEN_Y_COUNT + (y)))
+#define STATE_Y(s)          ((s) % MOVEGEN_Y_COUNT)
+#define STATE_X(s)          ((s) / MOVEGEN_Y_COUNT % TET_X_COUNT + TET_X_MIN)
+#define STATE_R(s)          ((s) / (MOVEGEN_Y_COUNT * TET_X_COUNT))
+#define SHIFT_Y(m, dy)      ((dy) >= 0 ? (m) << (dy) : (m) >> -(dy))
+
+_Static_assert(PF_H + PF_FLOOR <= 64, "a column of the board and its floor must fit in a 64 bit word");
+_Static_assert(MOVEGEN_STATES <= 0x10000, "states must fit in 16 bits");
+
+
+// TYPEDEFS //
+// rotation that covers the same cells as another one, like the two horizontal I rotations
+typedef struct {
+    int rotation;                       // -1 when there is none
+    int dx, dy;                         // offset from a placement in this rotation to the same cells in `rotation`
+} twin_t;
+
+
+// HELPER FUNCTIONS //
+// bitmap rows moved to the top left corner, so rotations covering the same shape compare equal
+static uint16_t normalise(const piece_t *p)
+{
+    uint16_t bm = 0;
+
+    for (int r = p->box.y_min; r <= p->box.y_max; r++)
+        bm |= (uint16_t)(((p->bitmap >> (12 - 4*r)) & 0xFu) << p->box.x_min & 0xFu) << (12 - 4*(r - p->box.y_min));
+    return bm;
+}
+
+static void find_twins(const shapes_t shape, twin_t twins[4])
+{
+    for (int r = 0; r < 4; r++) {
+        const piece_t *p = PIECE(shape, r);
+        twins[r].rotation = -1;
+        for (int t = 0; t < 4; t++) {
+            const piece_t *q = PIECE(shape, t);
+            if (t != r && normalise(p) == normalise(q)) {
+                twins[r].rotation = t;
+                twins[r].dx = p->box.x_min - q->box.x_min;
+                twins[r].dy = p->box.y_min - q->box.y_min;
+                break;
+            }
+        }
+    }
+}
+
+// every (rotation, x, y) the tetromino fits in, so the search tests bits instead of ANDing four rows each time
+static void build_fits(movegen_t *M, const engine_t *E, const shapes_t shape)
+{
+    uint64_t cols[ROW_BITS];            // bit y is set when row y is occupied at that bit of the row mask
+    const uint64_t in_range = (2ull << PF_H) - 1;
+
+    // walls are always full, the playfield only has cells from the top of the stack down, then the floor
+    for (int b = 0; b < ROW_BITS; b++)
+        cols[b] = (b < ROW_PAD || b >= ROW_PAD + PF_W) ? ~0ull : ((1ull << PF_FLOOR) - 1) << PF_H;
+    for (int y = PF_H - E->metrics.max_height; y < PF_H; y++)
+        for (unsigned m = E->rows[y] & (row_t)~ROW_EMPTY; m; m &= m - 1)
+            cols[__builtin_ctz(m)] |= 1ull << y;
+
+    for (int r = 0; r < 4; r++) {
+        const uint16_t bitmap = PIECE(shape, r)->bitmap;
+        for (int x = TET_X_MIN; x <= TET_X_MAX; x++) {
+            uint64_t blocked = 0;
+            for (unsigned bm = bitmap; bm; bm &= bm - 1) {
+                const int k = 15 - __builtin_ctz(bm);           // bitmap cell, row k / 4 and column k % 4
+                blocked |= cols[ROW_PAD + PF_W - 1 - (x + k % 4)] >> (k / 4);
+            }
+            M->fit[r][x - TET_X_MIN] = ~blocked & in_range;
+        }
+    }
+}
+
+// queue the top state of every vertical run in `found` that is new, each was reached from `dy` rows above by `in`
+static int push_runs(movegen_t *M, int tail, const int r, const int x, const uint64_t found, const int dy,
+                     const int from_r, const int from_x, const input_t in)
+{
+    uint64_t *visited = &M->visited[r][x - TET_X_MIN];
+    uint64_t fresh = found & ~*visited;
+
+    for (uint64_t tops = fresh & ~(fresh << 1); tops; tops &= tops - 1) {
+        const int y = __builtin_ctzll(tops);
+        const uint16_t s = STATE(r, x, y);
+        *visited |= 1ull << y;
+        M->queue[tail++] = s;
+        if (M->paths) {
+            M->parent[s] = STATE(from_r, from_x, y - dy);
+            M->via[s] = (uint8_t)in;
+        }
+    }
+    return tail;
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// fill `M->placements` with every resting place reachable by the falling tetromino. Placements covering the same cells
+// are reported once. Keep `paths` false unless `movegen_path()` will be called. returns the number of placements
+int movegen(movegen_t *M, const engine_t *E, const bool paths)
+{
+    const tetromino_t *tet = &E->tetromino;
+    twin_t twins[4];
+    int head = 0, tail = 0;
+
+    M->count = 0;
+    M->paths = paths;
+    if (!E->running)
+        return 0;
+    for (int r = 0; r < 4; r++)
+        for (int x = 0; x < TET_X_COUNT; x++)
+            M->visited[r][x] = M->placed[r][x] = 0;
+    find_twins(tet->shape, twins);
+    build_fits(M, E, tet->shape);
+
+    M->visited[tet->rotation][tet->x - TET_X_MIN] = 1ull << tet->y;
+    M->queue[tail++] = STATE(tet->rotation, tet->x, tet->y);
+    while (head < tail) {
+        const uint16_t s = M->queue[head++];
+        const int r = STATE_R(s), x = STATE_X(s), y = STATE_Y(s);
+        const uint64_t fit = M->fit[r][x - TET_X_MIN];
+        uint64_t *visited = &M->visited[r][x - TET_X_MIN];
+
+        // soft drop until something is in the way, or a state that was already searched
+        const uint64_t below = (fit & ~*visited) >> (y + 1);
+        const int depth = __builtin_ctzll(~below);
+        const uint64_t run = ((2ull << depth) - 1) << y;
+        *visited |= run;
+        if (paths)
+            for (int i = 1; i <= depth; i++) {
+                M->parent[s + i] = (uint16_t)(s + i - 1);
+                M->via[s + i] = IN_SOFT_DROP;
+            }
+
+        // the bottom of the run is resting, keep it unless its twin rotation already covered the same cells
+        if (!(fit >> (y + depth + 1) & 1) && M->count < MOVEGEN_MAX) {
+            const twin_t *t = &twins[r];
+            const int ry = y + depth, tx = x + t->dx, ty = ry + t->dy;
+            if (t->rotation < 0 || tx < TET_X_MIN || tx > TET_X_MAX || ty < 0 ||
+                !(M->placed[t->rotation][tx - TET_X_MIN] >> ty & 1)) {
+                M->placed[r][x - TET_X_MIN] |= 1ull << ry;
+                M->placements[M->count++] = (placement_t){(int8_t)x, (int8_t)ry, (int8_t)r, (uint16_t)(s + depth)};
+            }
+        }
+
+        // shift the whole run left and right
+        if (x > TET_X_MIN)
+            tail = push_runs(M, tail, r, x - 1, run & M->fit[r][x - 1 - TET_X_MIN], 0, r, x, IN_LEFT);
+        if (x < TET_X_MAX)
+            tail = push_runs(M, tail, r, x + 1, run & M->fit[r][x + 1 - TET_X_MIN], 0, r, x, IN_RIGHT);
+
+        // rotate it, each row of the run takes the first kick that fits exactly like `collision()`
+        if (tet->shape == O_tet)
+            continue;
+        for (int d = DIR_CW; d <= DIR_CCW; d++) {
+            const kick_t *k = PIECE(tet->shape, r)->kicks[d - DIR_CW];
+            const int nr = d == DIR_CW ? (r + 1) % 4 : (r + 3) % 4;
+            uint64_t left = run;
+            for (int i = 0; i < KICK_TESTS && left; i++) {
+                const int nx = x + k[i].x;
+                if (nx < TET_X_MIN || nx > TET_X_MAX)
+                    continue;
+                const uint64_t found = SHIFT_Y(left, k[i].y) & M->fit[nr][nx - TET_X_MIN];
+                left &= ~SHIFT_Y(found, -k[i].y);
+                tail = push_runs(M, tail, nr, nx, found, k[i].y, r, x, d == DIR_CW ? IN_CW : IN_CCW);
+            }
+        }
+    }
+    return M->count;
+}
+
+// write the inputs that steer the tetromino into placement `i` and lock it there, ending with IN_HARD_DROP.
+// Only valid after `movegen()` was called with `paths`. returns the number of inputs, -1 if `max` is too small
+int movegen_path(const movegen_t *M, const int i, input_t *out, const int max)
+{
+    const uint16_t start = M->queue[0];
+    int n = 0;
+
+    if (!M->paths || i < 0 || i >= M->count)
+        return -1;
+    for (uint16_t s = M->placements[i].state; s != start; s = M->parent[s])
+        n++;
+    if (n + 1 > max)
+        return -1;
+
+    out[n] = IN_HARD_DROP;
+    for (uint16_t s = M->placements[i].state, k = (uint16_t)n; s != start; s = M->parent[s])
+        out[--k] = (input_t)M->via[s];
+    return n + 1;
+}
@@ -0,0 +1,54 @@
+//======================================================================================================================
+// File Name    : movegen.h
+// Description  : Reachable placement generator: every distinct resting place the falling tetromino can be steered
+//                into with left, right, soft drop and SRS rotations, including tucks, spins and kick-only placements
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_MOVEGEN_H
+#define TETRIS_MOVEGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+#include "pieces.h"
+
+// MACROS //
+#define MOVEGEN_Y_COUNT     (PF_H + 1)                          // y from 0 to PF_H, see `piece_fits()`
+#define MOVEGEN_STATES      (4 * TET_X_COUNT * MOVEGEN_Y_COUNT)
+// A placement rests on the lowest row of a run of rows the tetromino fits in, and runs in a column are at least a row
+// apart, so no board offers more than one per two rows in each rotation and x
+#define MOVEGEN_MAX         (4 * TET_X_COUNT * ((MOVEGEN_Y_COUNT + 1) / 2))
+#define MOVEGEN_PATH_MAX    MOVEGEN_STATES
+
+
+// TYPEDEFS //
+typedef struct {
+    int8_t x;
+    int8_t y;
+    int8_t rotation;
+    uint16_t state;                     // BFS state the placement was first reached in, for `movegen_path()`
+} placement_t;
+
+// placements of one tetromino plus the BFS scratch space, reused between calls so nothing is allocated
+typedef struct {
+    placement_t placements[MOVEGEN_MAX];
+    int count;
+    bool paths;                         // `parent` and `via` were filled by the last call
+    uint64_t fit[4][TET_X_COUNT];       // bit y is set when the tetromino fits there, one word per rotation and x
+    uint64_t visited[4][TET_X_COUNT];   // same layout, the states already queued
+    uint64_t placed[4][TET_X_COUNT];    // same layout, the states already reported as placements
+    uint16_t queue[MOVEGEN_STATES];
+    uint16_t parent[MOVEGEN_STATES];
+    uint8_t via[MOVEGEN_STATES];        // input_t that led from `parent` into the state
+} movegen_t;
+
+
+// PROTOTYPES //
+int movegen(movegen_t *M, const engine_t *E, bool paths);
+int movegen_path(const movegen_t *M, int i, input_t *out, int max);
+
+#endif //TETRIS_MOVEGEN_H
@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "movegen.h"
+#include "pool.h"
+
+#define PERFT_MAX_DEPTH     8
+#define PERFT_SPLIT         2           // plies walked before the subtrees are handed out to the threads
+
+// set of board hashes, open addressing with 0 as the empty slot
+typedef struct {
+    uint64_t *keys;
+    size_t size;                        // slots, a power of two
+    size_t count;
+    bool zero;                          // the empty board, whose hash is 0, was added
+} set_t;
+
+typedef struct {
+    movegen_t gen[PERFT_MAX_DEPTH];     // one per ply, the parent's placements are still being walked
+    uint64_t nodes[PERFT_MAX_DEPTH];    // placements found at each ply
+    uint64_t *leaves;                   // placements at the last ply under each root placement
+    set_t boards[PERFT_MAX_DEPTH];      // boards after each ply, when counting them
+} worker_t;
+
+// a subtree left for the threads: the board before ply PERFT_SPLIT and the root placement it came from
+typedef struct {
+    engine_t state;
+    int root;
+} task_t;
+
+typedef struct {
+    int depth;
+    shapes_t seq[PERFT_MAX_DEPTH];      // the tetromino placed at each ply
+    bool boards;                        // count distinct boards too
+    worker_t *workers;
+    bool collect;                       // stop at ply PERFT_SPLIT and keep the board as a task
+    task_t *tasks;
+    int count;
+    int cap;
+} perft_t;
+
+static double now_s(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void set_add(set_t *S, const uint64_t key)
+{
+    size_t i;
+
+    if (!key) {
+        S->count += !S->zero;
+        S->zero = true;
+        return;
+    }
+    if (2 * (S->count + 1) > S->size) {
+        set_t grown = {.size = S->size ? 2 * S->size : 1024, .zero = S->zero};
+        if (!(grown.keys = calloc(grown.size, sizeof(uint64_t)))) {
+            fprintf(stderr, "out of memory for the board sets\n");
+            exit(1);
+        }
+        for (i = 0; i < S->size; i++)
+            if (S->keys[i])
+                set_add(&grown, S->keys[i]);
+        grown.count += S->zero;
+        free(S->keys);
+        *S = grown;
+    }
+    for (i = key & (S->size - 1); S->keys[i]; i = (i + 1) & (S->size - 1))
+        if (S->keys[i] == key)
+            return;
+    S->keys[i] = key;
+    S->count++;
+}
+
+// put `shape` at its spawn, false when it does not fit there
+static bool set_piece(engine_t *E, const shapes_t shape)
+{
+    E->tetromino.shape = shape;
+    E->tetromino.x = TETROMINO_SPAWN_X;
+    E->tetromino.y = TETROMINO_SPAWN_Y;
+    E->tetromino.rotation = 0;
+    E->tetromino.bitmap = PIECE(shape, 0)->bitmap;
+    return piece_fits(E->rows, PIECE(shape, 0), E->tetromino.x, E->tetromino.y);
+}
+
+// Count the placements of the tetromino of `E` at `ply` and under each of them. At the last ply they are only
+// counted, unless their boards are, which is where most of the placements are and what makes this fast
+static void walk(perft_t *P, worker_t *W, const engine_t *E, const int ply, const int root)
+{
+    movegen_t *M = &W->gen[ply];
+    engine_t child;
+
+    if (P->collect && ply == PERFT_SPLIT) {
+        if (P->count == P->cap) {
+            P->cap = P->cap ? 2 * P->cap : 1024;
+            if (!(P->tasks = realloc(P->tasks, (size_t)P->cap * sizeof(task_t)))) {
+                fprintf(stderr, "out of memory for the subtrees\n");
+                exit(1);
+            }
+        }
+        P->tasks[P->count++] = (task_t){*E, root};
+        return;
+    }
+
+    movegen(M, E, false);
+    W->nodes[ply] += (uint64_t)M->count;
+    if (ply == P->depth - 1 && !ply) {
+        for (int i = 0; i < M->count; i++)     // at depth 1 every root placement is its own only leaf
+            W->leaves[i]++;
+    } else if (ply == P->depth - 1) {
+        W->leaves[root] += (uint64_t)M->count;
+    }
+    if (ply == P->depth - 1 && !P->boards)
+        return;
+
+    for (int i = 0; i < M->count; i++) {
+        const placement_t *p = &M->placements[i];
+
+        child = *E;
+        child.tetromino.x = p->x;
+        child.tetromino.y = p->y;
+        child.tetromino.rotation = p->rotation;
+        child.tetromino.bitmap = PIECE(child.tetromino.shape, p->rotation)->bitmap;
+        engine_step(&child, IN_HARD_DROP);
+        if (P->boards)
+            set_add(&W->boards[ply], child.hash);
+
+        // a game that ended has no placements under it
+        if (ply + 1 < P->depth && child.running && set_piece(&child, P->seq[ply + 1]))
+            walk(P, W, &child, ply + 1, ply ? root : i);
+    }
+}
+
+static void run_task(void *ctx, const int idx, const int worker)
+{
+    perft_t *P = ctx;
+
+    walk(P, &P->workers[worker], &P->tasks[idx].state, PERFT_SPLIT, P->tasks[idx].root);
+}
+
+// read a board given as rows of '.' and '#' from the top of the stack down, separated by '/'
+static bool parse_board(engine_t *E, const char *s)
+{
+    const int n = (int)(strlen(s) + 1) / (PF_W + 1);
+
+    if ((int)strlen(s) != n * (PF_W + 1) - 1 || n > PLAYFIELD_HEIGHT - 1)
+        return false;
+    for (int r = 0; r < n; r++) {
+        const int y = PF_H - n + r;
+        for (int x = 0; x < PF_W; x++) {
+            const char c = s[r * (PF_W + 1) + x];
+            if (c == '#') {
+                E->rows[y] |= (row_t)ROW_BIT(x);
+                E->colors[y][x] = O_tet;
+            } else if (c != '.') {
+                return false;
+            }
+        }
+        if ((r < n - 1 && s[r * (PF_W + 1) + PF_W] != '/') || E->rows[y] == ROW_FULL)
+            return false;
+    }
+    engine_rebuild(E);
+    return true;
+}
+
+// Count every placement reachable from a board to a depth, like chess perft: ply 1 places the current tetromino
+// everywhere it can go, ply 2 places the next one on each of those boards, and so on. A placement is a set of cells
+// the tetromino can be locked on with the moves `engine_step()` allows, SRS kicks included, so the counts check
+// `movegen()` and the kicks against known answers and time how fast placements are generated
+int main(int argc, char *argv[])
+{
+    static const char shape_chars[] = " IOTSZJL";
+    perft_t P = {.depth = 0};
+    engine_t E;
+    uint64_t seed = 1, total = 0;
+    const char *board = NULL, *seq = NULL, *c;
+    int opt, threads = pool_cpus(), divide = 0, w, h;
+    double start, secs;
+
+    while ((opt = getopt(argc, argv, "B:j:s:q:b:uv")) != -1) {
+        switch (opt) {
+            case 'B':
+                if (sscanf(optarg, "%dx%d", &w, &h) != 2) {
+                    fprintf(stderr, "%s: -B takes a board size like 10x20\n", argv[0]);
+                    return 2;
+                }
+                if (w != PF_W || h != BOARD_H) {
+                    engine_exec_board("tetris-perft", w, h, argv);
+                    fprintf(stderr, "%s: no build for the %dx%d board\n", argv[0], w, h);
+                    return 2;
+                }
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'q':
+                seq = optarg;
+                break;
+            case 'b':
+                board = optarg;
+                break;
+            case 'u':
+                P.boards = true;
+                break;
+            case 'v':
+                divide = 1;
+                break;
+            default:
+                optind = argc;
+        }
+    }
+    if (optind == argc - 1)
+        P.depth = atoi(argv[optind]);
+    if (P.depth < 1 || P.depth > PERFT_MAX_DEPTH) {
+        fprintf(stderr, "usage: %s [-B WxH] [-j threads] [-s seed] [-q pieces] [-b board] [-u] [-v] depth\n"
+                        "  depth 1 to %d, pieces like TSZ one per ply (default: the seed's bag), board like\n"
+                        "  ..##....../.#######.# from the top of the stack down, -u counts distinct boards,\n"
+                        "  -v gives the count under each first placement\n", argv[0], PERFT_MAX_DEPTH);
+        return 2;
+    }
+
+    // the board and the tetromino of every ply
+    engine_init(&E, seed);
+    if (board && !parse_board(&E, board)) {
+        fprintf(stderr, "%s: the board must be rows of %d '.' or '#', not full, separated by '/'\n", argv[0], PF_W);
+        return 2;
+    }
+    P.seq[0] = E.tetromino.shape;
+    engine_preview(&E, &P.seq[1], P.depth - 1);
+    for (int i = 0; seq && i < P.depth; i++) {
+        if (!seq[i] || seq[i] == ' ' || !(c = strchr(shape_chars, seq[i]))) {
+            fprintf(stderr, "%s: -q needs one of %s for each of the %d plies\n", argv[0], shape_chars + 1, P.depth);
+            return 2;
+        }
+        P.seq[i] = (shapes_t)(c - shape_chars);
+    }
+    if (!set_piece(&E, P.seq[0])) {
+        fprintf(stderr, "%s: the first tetromino does not fit at its spawn\n", argv[0]);
+        return 2;
+    }
+
+    if (threads < 1)
+        threads = 1;
+    if (!(P.workers = calloc((size_t)threads, sizeof(worker_t))))
+        return 1;
+    for (int i = 0; i < threads; i++)
+        if (!(P.workers[i].leaves = calloc(MOVEGEN_MAX, sizeof(uint64_t))))
+            return 1;
+
+    // the first plies are walked here and leave the subtrees under them to the threads
+    start = now_s();
+    P.collect = P.depth > PERFT_SPLIT;
+    walk(&P, &P.workers[0], &E, 0, 0);
+    P.collect = false;
+    if (P.count && pool_run(threads, P.count, run_task, &P)) {
+        fprintf(stderr, "%s: cannot start the thread pool\n", argv[0]);
+        return 1;
+    }
+    secs = now_s() - start;
+
+    // add up what every worker found, the placements under each root are in the order worker 0 found the roots in
+    worker_t *W = &P.workers[0];
+    for (int i = 1; i < threads; i++) {
+        for (int ply = 0; ply < P.depth; ply++) {
+            W->nodes[ply] += P.workers[i].nodes[ply];
+            for (size_t k = 0; k < P.workers[i].boards[ply].size; k++)
+                if (P.workers[i].boards[ply].keys[k])
+                    set_add(&W->boards[ply], P.workers[i].boards[ply].keys[k]);
+            if (P.workers[i].boards[ply].zero)
+                set_add(&W->boards[ply], 0);
+        }
+        for (int r = 0; r < MOVEGEN_MAX; r++)
+            W->leaves[r] += P.workers[i].leaves[r];
+    }
+
+    if (divide) {
+        for (int r = 0; r < W->gen[0].count; r++) {
+            const placement_t *p = &W->gen[0].placements[r];
+            printf("%c r%d x%d y%d: %llu\n", shape_chars[P.seq[0]], p->rotation, p->x, p->y,
+                   (unsigned long long)W->leaves[r]);
+        }
+    }
+    printf("board %dx%d, pieces ", PF_W, BOARD_H);
+    for (int ply = 0; ply < P.depth; ply++)
+        putchar(shape_chars[P.seq[ply]]);
+    putchar('\n');
+    for (int ply = 0; ply < P.depth; ply++) {
+        total += W->nodes[ply];
+        printf("depth %d: %llu placements", ply + 1, (unsigned long long)W->nodes[ply]);
+        if (P.boards)
+            printf(", %zu boards", W->boards[ply].count);
+        putchar('\n');
+    }
+    printf("%llu placements on %d threads in %.3f s, %.0f placements/s\n", (unsigned long long)total,
+           P.count < threads ? (P.count ? P.count : 1) : threads, secs, secs > 0 ? (double)total / secs : 0);
+
+    for (int i = 0; i < threads; i++) {
+        for (int ply = 0; ply < PERFT_MAX_DEPTH; ply++)
+            free(P.workers[i].boards[ply].keys);
+        free(P.workers[i].leaves);
+    }
+    free(P.workers);
+    free(P.tasks);
+    return 0;
+}
@@ -0,0 +1,121 @@
+//======================================================================================================================
+// File Name    : pieces.c
+// Description  : Read-only shape/rotation table, every field is a constant expression built by the compiler
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include "pieces.h"
+
+// MACROS //
+#define BM(a, b, c, d)          (uint16_t)(((a) << 12u) | ((b) << 8u) | ((c) << 4u) | (d))
+// bitmap rows shifted into place for a single x, then for every x from TET_X_MIN to TET_X_MAX. X_TO_<w> lists x
+// from -3 to w-1, the board width picks one so the table is exactly as wide as the board
+#define AT_X(bm, x)             {TET_ROW(bm, 0, x), TET_ROW(bm, 1, x), TET_ROW(bm, 2, x), TET_ROW(bm, 3, x)}
+#define X_TO_4(bm)              AT_X(bm, -3), AT_X(bm, -2), AT_X(bm, -1), AT_X(bm, 0), AT_X(bm, 1), AT_X(bm, 2),   \
+                                AT_X(bm, 3)
+#define X_TO_5(bm)              X_TO_4(bm), AT_X(bm, 4)
+#define X_TO_6(bm)              X_TO_5(bm), AT_X(bm, 5)
+#define X_TO_7(bm)              X_TO_6(bm), AT_X(bm, 6)
+#define X_TO_8(bm)              X_TO_7(bm), AT_X(bm, 7)
+#define X_TO_9(bm)              X_TO_8(bm), AT_X(bm, 8)
+#define X_TO_10(bm)             X_TO_9(bm), AT_X(bm, 9)
+#define X_TO_11(bm)             X_TO_10(bm), AT_X(bm, 10)
+#define X_TO_12(bm)             X_TO_11(bm), AT_X(bm, 11)
+#define X_TO_13(bm)             X_TO_12(bm), AT_X(bm, 12)
+#define X_TO_14(bm)             X_TO_13(bm), AT_X(bm, 13)
+#define X_TO_15(bm)             X_TO_14(bm), AT_X(bm, 14)
+#define X_TO_16(bm)             X_TO_15(bm), AT_X(bm, 15)
+#define X_TO_17(bm)             X_TO_16(bm), AT_X(bm, 16)
+#define X_TO_18(bm)             X_TO_17(bm), AT_X(bm, 17)
+#define X_TO_19(bm)             X_TO_18(bm), AT_X(bm, 18)
+#define X_TO_20(bm)             X_TO_19(bm), AT_X(bm, 19)
+#define X_TO_21(bm)             X_TO_20(bm), AT_X(bm, 20)
+#define X_TO_22(bm)             X_TO_21(bm), AT_X(bm, 21)
+#define X_TO_23(bm)             X_TO_22(bm), AT_X(bm, 22)
+#define X_TO_24(bm)             X_TO_23(bm), AT_X(bm, 23)
+#define X_TO_25(bm)             X_TO_24(bm), AT_X(bm, 24)
+#define X_TO_26(bm)             X_TO_25(bm), AT_X(bm, 25)
+#define X_TO(w, bm)             X_TO_##w(bm)
+#define X_TO_W(w, bm)           X_TO(w, bm)                 // expands BOARD_W before pasting it
+#define ALL_X(bm)               {X_TO_W(BOARD_W, bm)}
+// first and last occupied column of a 4 bit row, first and last occupied row of a bitmap
+#define NIB_FIRST(n)            ((n) & 8 ? 0 : (n) & 4 ? 1 : (n) & 2 ? 2 : 3)
+#define NIB_LAST(n)             ((n) & 1 ? 3 : (n) & 2 ? 2 : (n) & 4 ? 1 : 0)
+#define BOX(a, b, c, d)         {NIB_FIRST((a) | (b) | (c) | (d)), NIB_LAST((a) | (b) | (c) | (d)),                \
+                                 (a) ? 0 : (b) ? 1 : (c) ? 2 : 3, (d) ? 3 : (c) ? 2 : (b) ? 1 : 0}
+// lowest occupied row of each column of a bitmap, -1 when the column is empty
+#define BIT(n, col)             (((n) >> (3 - (col))) & 1)
+#define COL_LOW(a, b, c, d, col) (BIT(d, col) ? 3 : BIT(c, col) ? 2 : BIT(b, col) ? 1 : BIT(a, col) ? 0 : -1)
+#define COL_BOTTOM(a, b, c, d)  {COL_LOW(a, b, c, d, 0), COL_LOW(a, b, c, d, 1), COL_LOW(a, b, c, d, 2),             \
+                                 COL_LOW(a, b, c, d, 3)}
+#define ENTRY(a, b, c, d, k)    {.bitmap = BM(a, b, c, d), .rows = ALL_X(BM(a, b, c, d)), .box = BOX(a, b, c, d),   \
+                                 .col_bottom = COL_BOTTOM(a, b, c, d), .kicks = k}
+
+// SRS kick offsets leaving each rotation, clockwise first. Y already points down the playfield
+#define JLSTZ_KICKS_0           {{{+0, +0}, {-1, +0}, {-1, -1}, {+0, +2}, {-1, +2}},   \
+                                 {{+0, +0}, {+1, +0}, {+1, -1}, {+0, +2}, {+1, +2}}}
+#define JLSTZ_KICKS_1           {{{+0, +0}, {+1, +0}, {+1, +1}, {+0, -2}, {+1, -2}},   \
+                                 {{+0, +0}, {+1, +0}, {+1, +1}, {+0, -2}, {+1, -2}}}
+#define JLSTZ_KICKS_2           {{{+0, +0}, {+1, +0}, {+1, -1}, {+0, +2}, {+1, +2}},   \
+                                 {{+0, +0}, {-1, +0}, {-1, -1}, {+0, +2}, {-1, +2}}}
+#define JLSTZ_KICKS_3           {{{+0, +0}, {-1, +0}, {-1, +1}, {+0, -2}, {-1, -2}},   \
+                                 {{+0, +0}, {-1, +0}, {-1, +1}, {+0, -2}, {-1, -2}}}
+#define I_KICKS_0               {{{+0, +0}, {-2, +0}, {+1, +0}, {+1, -2}, {-2, +1}},   \
+                                 {{+0, +0}, {+2, +0}, {-1, +0}, {-1, -2}, {+2, +1}}}
+#define I_KICKS_1               {{{+0, +0}, {-1, +0}, {+2, +0}, {-1, -2}, {+2, +1}},   \
+                                 {{+0, +0}, {+2, +0}, {-1, +0}, {+2, -1}, {-1, +2}}}
+#define I_KICKS_2               {{{+0, +0}, {+2, +0}, {-1, +0}, {+2, -1}, {-1, +1}},   \
+                                 {{+0, +0}, {-2, +0}, {+1, +0}, {-2, -1}, {+1, +1}}}
+#define I_KICKS_3               {{{+0, +0}, {-2, +0}, {+1, +0}, {-2, -1}, {+1, +2}},   \
+                                 {{+0, +0}, {+1, +0}, {-2, +0}, {+1, -2}, {-2, +1}}}
+#define NO_KICKS                {{{0, 0}}}
+
+
+// DATA //
+const piece_t piece_table[BAG_SIZE + 1][4] = {
+    [I_tet] = {
+        ENTRY(0b0000, 0b1111, 0b0000, 0b0000, I_KICKS_0),
+        ENTRY(0b0010, 0b0010, 0b0010, 0b0010, I_KICKS_1),
+        ENTRY(0b0000, 0b0000, 0b1111, 0b0000, I_KICKS_2),
+        ENTRY(0b0100, 0b0100, 0b0100, 0b0100, I_KICKS_3),
+    },
+    [O_tet] = {
+        ENTRY(0b0110, 0b0110, 0b0000, 0b0000, NO_KICKS),
+        ENTRY(0b0110, 0b0110, 0b0000, 0b0000, NO_KICKS),
+        ENTRY(0b0110, 0b0110, 0b0000, 0b0000, NO_KICKS),
+        ENTRY(0b0110, 0b0110, 0b0000, 0b0000, NO_KICKS),
+    },
+    [T_tet] = {
+        ENTRY(0b0100, 0b1110, 0b0000, 0b0000, JLSTZ_KICKS_0),
+        ENTRY(0b0100, 0b0110, 0b0100, 0b0000, JLSTZ_KICKS_1),
+        ENTRY(0b0000, 0b1110, 0b0100, 0b0000, JLSTZ_KICKS_2),
+        ENTRY(0b0100, 0b1100, 0b0100, 0b0000, JLSTZ_KICKS_3),
+    },
+    [S_tet] = {
+        ENTRY(0b0110, 0b1100, 0b0000, 0b0000, JLSTZ_KICKS_0),
+        ENTRY(0b0100, 0b0110, 0b0010, 0b0000, JLSTZ_KICKS_1),
+        ENTRY(0b0000, 0b0110, 0b1100, 0b0000, JLSTZ_KICKS_2),
+        ENTRY(0b1000, 0b1100, 0b0100, 0b0000, JLSTZ_KICKS_3),
+    },
+    [Z_tet] = {
+        ENTRY(0b1100, 0b0110, 0b0000, 0b0000, JLSTZ_KICKS_0),
+        ENTRY(0b0010, 0b0110, 0b0100, 0b0000, JLSTZ_KICKS_1),
+        ENTRY(0b0000, 0b1100, 0b0110, 0b0000, JLSTZ_KICKS_2),
+        ENTRY(0b0100, 0b1100, 0b1000, 0b0000, JLSTZ_KICKS_3),
+    },
+    [J_tet] = {
+        ENTRY(0b1000, 0b1110, 0b0000, 0b0000, JLSTZ_KICKS_0),
+        ENTRY(0b0110, 0b0100, 0b0100, 0b0000, JLSTZ_KICKS_1),
+        ENTRY(0b0000, 0b1110, 0b0010, 0b0000, JLSTZ_KICKS_2),
+        ENTRY(0b0100, 0b0100, 0b1100, 0b0000, JLSTZ_KICKS_3),
+    },
+    [L_tet] = {
+        ENTRY(0b0010, 0b1110, 0b0000, 0b0000, JLSTZ_KICKS_0),
+        ENTRY(0b0100, 0b0100, 0b0110, 0b0000, JLSTZ_KICKS_1),
+        ENTRY(0b0000, 0b1110, 0b1000, 0b0000, JLSTZ_KICKS_2),
+        ENTRY(0b1100, 0b0100, 0b0100, 0b0000, JLSTZ_KICKS_3),
+    },
+};
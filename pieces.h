@@ -0,0 +1,57 @@
+//======================================================================================================================
+// File Name    : pieces.h
+// Description  : Precomputed, read-only tetromino data shared by the engine and any search code
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_PIECES_H
+#define TETRIS_PIECES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+#define TET_X_COUNT         (TET_X_MAX - TET_X_MIN + 1)
+#define KICK_TESTS          5
+#define PIECE(shape, rot)   (&piece_table[(shape)][(rot)])
+
+
+// TYPEDEFS //
+// offset applied to a rotated tetromino, y grows down the playfield
+typedef struct {
+    int8_t x;
+    int8_t y;
+} kick_t;
+
+typedef struct {
+    uint16_t bitmap;                        // 4x4 bitmap, row 0 in the high nibble, column 0 in the high bit
+    row_t rows[TET_X_COUNT][4];             // bitmap rows as row masks, pre-shifted for every x from TET_X_MIN
+    struct {
+        int8_t x_min, x_max;                // occupied columns within the bitmap
+        int8_t y_min, y_max;                // occupied rows within the bitmap
+    } box;
+    int8_t col_bottom[4];                   // lowest occupied row of each bitmap column, -1 when empty
+    kick_t kicks[2][KICK_TESTS];            // SRS tests when leaving this rotation, [DIR_CW-1] or [DIR_CCW-1]
+} piece_t;
+
+
+// DATA //
+extern const piece_t piece_table[BAG_SIZE + 1][4];  // [shape][rotation], shape 0 is unused
+
+
+// FUNCTIONS //
+// returns true if the piece fits at (x, y): each pre-shifted bitmap row is ANDed against its board row
+static inline bool piece_fits(const row_t rows[PF_H + PF_FLOOR], const piece_t *p, const int x, const int y)
+{
+    if (x < TET_X_MIN || x > TET_X_MAX || y < 0 || y > PF_H)
+        return false;
+
+    const row_t *m = p->rows[x - TET_X_MIN];
+    return !((m[0] & rows[y]) | (m[1] & rows[y + 1]) | (m[2] & rows[y + 2]) | (m[3] & rows[y + 3]));
+}
+
+#endif //TETRIS_PIECES_H
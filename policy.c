@@ -0,0 +1,107 @@
+//======================================================================================================================
+// File Name    : policy.c
+// Description  : Built-in greedy player. Tries every rotation and column reachable by rotating at spawn and then
+//                shifting, hard drops each on a copy of the game and keeps the one with the best board
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <limits.h>
+#include "policy.h"
+
+// MACROS //
+// board weights, scaled by 1000
+#define W_HEIGHT            (-510)
+#define W_LINES             760
+#define W_HOLES             (-356)
+#define W_BUMPINESS         (-184)
+
+
+// HELPER FUNCTIONS //
+// hard drop a copy of `E` and score the result
+static long drop_and_score(const engine_t *E)
+{
+    engine_t tmp = *E;
+
+    engine_step(&tmp, IN_HARD_DROP);
+    if (!tmp.running)
+        return LONG_MIN;
+    return policy_evaluate(&tmp, tmp.lines - E->lines);
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// score a board, higher is better
+long policy_evaluate(const engine_t *E, const int lines)
+{
+    const metrics_t *M = &E->metrics;
+    long height = 0, bumpiness = 0;
+
+    for (int x = 0; x < PF_W; x++) {
+        height += M->heights[x];
+        if (x > 0)
+            bumpiness += M->heights[x] > M->heights[x-1] ? M->heights[x] - M->heights[x-1]
+                                                         : M->heights[x-1] - M->heights[x];
+    }
+    return W_HEIGHT * height + W_LINES * lines + W_HOLES * M->holes + W_BUMPINESS * bumpiness;
+}
+
+// find the best placement for the current tetromino, `best->count` is 0 when the game is over
+void policy_greedy(const engine_t *E, plan_t *best)
+{
+    static const struct { input_t in; int count; } turns[4] = {
+        {IN_NONE, 0}, {IN_CW, 1}, {IN_CW, 2}, {IN_CCW, 1},
+    };
+    plan_t P;
+    engine_t rot;
+    long s;
+
+    best->count = 0;
+    best->score = LONG_MIN;
+    if (!E->running)
+        return;
+
+    for (int r = 0; r < 4; r++) {
+        // rotate at spawn, skipping rotations that could not be reached
+        rot = *E;
+        P.count = 0;
+        for (int i = 0; i < turns[r].count; i++) {
+            P.inputs[P.count++] = turns[r].in;
+            engine_step(&rot, turns[r].in);
+        }
+        if (rot.tetromino.rotation != r)
+            continue;
+
+        // then every column, shifting left from spawn until the wall and then right until the other wall
+        const int base = P.count;
+        for (int dir = -1; dir <= 1; dir += 2) {
+            engine_t shifted = rot;
+            for (int n = dir < 0 ? 0 : 1;; n++) {
+                if (n > 0 && !(engine_step(&shifted, dir < 0 ? IN_LEFT : IN_RIGHT) & EV_MOVED))
+                    break;
+                P.count = base;
+                for (int i = 0; i < n; i++)
+                    P.inputs[P.count++] = dir < 0 ? IN_LEFT : IN_RIGHT;
+                P.inputs[P.count++] = IN_HARD_DROP;
+                if ((s = drop_and_score(&shifted)) > best->score || best->count == 0) {
+                    *best = P;
+                    best->score = s;
+                }
+            }
+        }
+    }
+}
+
+// play one tetromino with `policy_greedy()`, returns the events of its last step
+unsigned policy_play(engine_t *E)
+{
+    plan_t P;
+    unsigned ev = EV_NONE;
+
+    policy_greedy(E, &P);
+    for (int i = 0; i < P.count; i++)
+        ev = engine_step(E, P.inputs[i]);
+    return ev;
+}
@@ -0,0 +1,33 @@
+//======================================================================================================================
+// File Name    : policy.h
+// Description  : Built-in greedy player, used to drive headless games for batch simulation
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_POLICY_H
+#define TETRIS_POLICY_H
+
+#include "engine.h"
+
+// MACROS //
+#define POLICY_MAX_INPUTS   (2 + PF_W + 1)  // rotations, shifts and the hard drop of one placement
+
+
+// TYPEDEFS //
+// inputs that take the current tetromino from its spawn to a resting place, always ending in IN_HARD_DROP
+typedef struct {
+    input_t inputs[POLICY_MAX_INPUTS];
+    int count;
+    long score;
+} plan_t;
+
+
+// PROTOTYPES //
+long policy_evaluate(const engine_t *E, int lines);
+void policy_greedy(const engine_t *E, plan_t *best);
+unsigned policy_play(engine_t *E);
+
+#endif //TETRIS_POLICY_H
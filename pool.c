@@ -0,0 +1,263 @@
+//======================================================================================================================
+// File Name    : pool.c
+// Description  : Every worker starts with an equal slice of the job indices and takes jobs from the front of its own
+//                slice. A worker that runs dry steals the back half of another worker's slice, so long jobs on one
+//                core do not leave the others idle. A slice is one atomic word, taking and stealing are both one CAS
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+// MACROS //
+#define CACHE_LINE          64
+#define SLICE(lo, hi)       (((uint64_t)(uint32_t)(hi) << 32) | (uint32_t)(lo))
+#define SLICE_LO(s)         ((int)(uint32_t)(s))
+#define SLICE_HI(s)         ((int)(uint32_t)((s) >> 32))
+
+
+// TYPEDEFS //
+// jobs [lo, hi) not yet taken, on its own cache line so workers do not slow each other down
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t slice;
+} deque_t;
+
+// one call of `fn` for every index in [0, count)
+typedef struct {
+    deque_t *deques;
+    int threads;
+    pool_fn fn;
+    void *ctx;
+} run_t;
+
+typedef struct {
+    run_t *run;
+    pool_t *pool;                       // NULL for the threads of a single `pool_run()`
+    int id;
+} worker_t;
+
+// threads kept waiting between runs, `generation` counts the runs handed out so far
+struct pool {
+    run_t run;
+    pthread_mutex_t lock;
+    pthread_cond_t wake, done;
+    uint64_t generation;
+    int busy;                           // started threads still working on the current run
+    int started;
+    bool stop;
+    pthread_t *tids;
+    worker_t *workers;
+};
+
+
+// HELPER FUNCTIONS //
+// deal [0, count) out to the workers in equal slices
+static void deal(run_t *R, const int count)
+{
+    for (int i = 0; i < R->threads; i++)
+        atomic_init(&R->deques[i].slice, SLICE((int64_t)count * i / R->threads, (int64_t)count * (i + 1) / R->threads));
+}
+
+// take the first job of our own slice, -1 when it is empty
+static int take(deque_t *D)
+{
+    uint64_t s = atomic_load_explicit(&D->slice, memory_order_relaxed);
+
+    while (SLICE_LO(s) < SLICE_HI(s)) {
+        if (atomic_compare_exchange_weak(&D->slice, &s, SLICE(SLICE_LO(s) + 1, SLICE_HI(s))))
+            return SLICE_LO(s);
+    }
+    return -1;
+}
+
+// move the back half of some other worker's slice into our own, 0 when every other slice is empty
+static int steal(run_t *P, const int self)
+{
+    for (int i = 1; i < P->threads; i++) {
+        deque_t *victim = &P->deques[(self + i) % P->threads];
+        uint64_t s = atomic_load_explicit(&victim->slice, memory_order_relaxed);
+
+        while (SLICE_LO(s) < SLICE_HI(s)) {
+            int n = SLICE_HI(s) - SLICE_LO(s);
+            int mid = SLICE_HI(s) - (n + 1) / 2;
+            if (atomic_compare_exchange_weak(&victim->slice, &s, SLICE(SLICE_LO(s), mid))) {
+                atomic_store(&P->deques[self].slice, SLICE(mid, SLICE_HI(s)));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *work(void *arg)
+{
+    worker_t *W = arg;
+    run_t *P = W->run;
+    int idx;
+
+    do {
+        while ((idx = take(&P->deques[W->id])) >= 0)
+            P->fn(P->ctx, idx, W->id);
+    } while (steal(P, W->id));
+    return NULL;
+}
+
+// a thread of a `pool_t`: sleep until the next run is handed out, work on it and report back
+static void *serve(void *arg)
+{
+    worker_t *W = arg;
+    pool_t *P = W->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&P->lock);
+    for (;;) {
+        while (P->generation == seen && !P->stop)
+            pthread_cond_wait(&P->wake, &P->lock);
+        if (P->stop)
+            break;
+        seen = P->generation;
+        pthread_mutex_unlock(&P->lock);
+        work(W);
+        pthread_mutex_lock(&P->lock);
+        if (!--P->busy)
+            pthread_cond_signal(&P->done);
+    }
+    pthread_mutex_unlock(&P->lock);
+    return NULL;
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+int pool_cpus(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// call `fn` once for every index in [0, count) on `threads` threads, returns when all are done, -1 on failure
+int pool_run(int threads, const int count, const pool_fn fn, void *ctx)
+{
+    run_t P = {.fn = fn, .ctx = ctx};
+    pthread_t *tids;
+    worker_t *workers;
+    int started, status = 0;
+
+    if (count <= 0)
+        return 0;
+    if (threads > count)
+        threads = count;
+    if (threads < 1)
+        threads = 1;
+    P.threads = threads;
+
+    P.deques = aligned_alloc(CACHE_LINE, sizeof(deque_t) * (size_t)threads);
+    workers = malloc(sizeof(worker_t) * (size_t)threads);
+    tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    if (!P.deques || !workers || !tids) {
+        status = -1;
+        goto out;
+    }
+
+    deal(&P, count);
+    for (int i = 0; i < threads; i++)
+        workers[i] = (worker_t){.run = &P, .id = i};
+
+    // the calling thread is worker 0, if a thread cannot be started its slice is stolen by the others
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, work, &workers[started]))
+            break;
+    }
+    work(&workers[0]);
+    for (int i = 1; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+out:
+    free(tids);
+    free(workers);
+    free(P.deques);
+    return status;
+}
+
+// start `threads` - 1 threads that wait for `pool_exec()`, so a caller running many short jobs, such as one search per
+// piece, does not create and join threads every time. Returns NULL on failure
+pool_t *pool_create(int threads)
+{
+    pool_t *P = calloc(1, sizeof(pool_t));
+
+    if (!P)
+        return NULL;
+    if (threads < 1)
+        threads = 1;
+    P->run.threads = threads;
+    P->run.deques = aligned_alloc(CACHE_LINE, sizeof(deque_t) * (size_t)threads);
+    P->workers = malloc(sizeof(worker_t) * (size_t)threads);
+    P->tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    if (!P->run.deques || !P->workers || !P->tids || pthread_mutex_init(&P->lock, NULL)) {
+        free(P->tids);
+        free(P->workers);
+        free(P->run.deques);
+        free(P);
+        return NULL;
+    }
+    pthread_cond_init(&P->wake, NULL);
+    pthread_cond_init(&P->done, NULL);
+    for (int i = 0; i < threads; i++)
+        P->workers[i] = (worker_t){.run = &P->run, .pool = P, .id = i};
+
+    // as in `pool_run()` the calling thread is worker 0, and the slice of a thread that did not start is stolen
+    for (P->started = 1; P->started < threads; P->started++) {
+        if (pthread_create(&P->tids[P->started], NULL, serve, &P->workers[P->started]))
+            break;
+    }
+    return P;
+}
+
+// `pool_run()` on the threads of `P`, returns when all jobs are done. Not safe to call from two threads at once
+int pool_exec(pool_t *P, const int count, const pool_fn fn, void *ctx)
+{
+    if (count <= 0)
+        return 0;
+    P->run.fn = fn;
+    P->run.ctx = ctx;
+    deal(&P->run, count);
+
+    pthread_mutex_lock(&P->lock);
+    P->busy = P->started - 1;
+    P->generation++;
+    pthread_cond_broadcast(&P->wake);
+    pthread_mutex_unlock(&P->lock);
+
+    work(&P->workers[0]);
+    pthread_mutex_lock(&P->lock);
+    while (P->busy)
+        pthread_cond_wait(&P->done, &P->lock);
+    pthread_mutex_unlock(&P->lock);
+    return 0;
+}
+
+void pool_destroy(pool_t *P)
+{
+    if (!P)
+        return;
+    pthread_mutex_lock(&P->lock);
+    P->stop = true;
+    pthread_cond_broadcast(&P->wake);
+    pthread_mutex_unlock(&P->lock);
+    for (int i = 1; i < P->started; i++)
+        pthread_join(P->tids[i], NULL);
+    pthread_cond_destroy(&P->wake);
+    pthread_cond_destroy(&P->done);
+    pthread_mutex_destroy(&P->lock);
+    free(P->tids);
+    free(P->workers);
+    free(P->run.deques);
+    free(P);
+}
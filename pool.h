@@ -0,0 +1,27 @@
+//======================================================================================================================
+// File Name    : pool.h
+// Description  : Work-stealing thread pool for running many independent jobs, such as whole games, on every core
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_POOL_H
+#define TETRIS_POOL_H
+
+// TYPEDEFS //
+typedef struct pool pool_t;             // threads kept between runs, see `pool_create()`
+
+// runs job `idx` on thread `worker`, workers are numbered from 0 and the calling thread is worker 0
+typedef void (*pool_fn)(void *ctx, int idx, int worker);
+
+
+// PROTOTYPES //
+int pool_cpus(void);
+int pool_run(int threads, int count, pool_fn fn, void *ctx);
+pool_t *pool_create(int threads);
+int pool_exec(pool_t *P, int count, pool_fn fn, void *ctx);
+void pool_destroy(pool_t *P);
+
+#endif //TETRIS_POOL_H
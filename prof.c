@@ -0,0 +1,98 @@
+//======================================================================================================================
+// File Name    : prof.c
+// Description  : Latency histograms: bucket b holds values with the same top HIST_SUB_BITS + 1 bits, like a float with
+//                a 2 bit mantissa, so percentiles are exact to a quarter of a power of two from ns to minutes
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <string.h>
+#include "prof.h"
+
+// MACROS //
+#define SUB                 (1 << HIST_SUB_BITS)
+
+
+// DATA //
+prof_t prof;
+
+static const char *names[PROF_COUNT] = {
+    [PROF_INPUT] = "input",
+    [PROF_STEP] = "step",
+    [PROF_PLAYFIELD] = "playfield",
+    [PROF_SCOREBOARD] = "scoreboard",
+    [PROF_NEXTP] = "nextp",
+    [PROF_REFRESH] = "refresh",
+    [PROF_FRAME] = "frame",
+    [PROF_LATENCY] = "input->render",
+    [PROF_JITTER] = "tick jitter",
+};
+
+
+// HELPER FUNCTIONS //
+static int bucket(const int64_t ns)
+{
+    int top, b;
+
+    if (ns < SUB)
+        return ns < 0 ? 0 : (int)ns;
+    top = 63 - __builtin_clzll((uint64_t)ns);
+    b = (top - HIST_SUB_BITS + 1) * SUB + (int)((ns >> (top - HIST_SUB_BITS)) & (SUB - 1));
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+// smallest value that falls in bucket `b`
+static int64_t bucket_floor(const int b)
+{
+    if (b < SUB)
+        return b;
+    return (int64_t)(SUB + b % SUB) << (b / SUB - 1);
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+void hist_add(hist_t *H, const int64_t ns)
+{
+    H->counts[bucket(ns)]++;
+    H->count++;
+    if (ns > H->max)
+        H->max = ns;
+}
+
+// value under which a fraction `p` of the samples fall, rounded down to its bucket, 0 without samples
+int64_t hist_percentile(const hist_t *H, const double p)
+{
+    uint64_t want = (uint64_t)(p * (double)H->count), seen = 0;
+
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += H->counts[b];
+        if (seen > want)
+            return bucket_floor(b) < H->max ? bucket_floor(b) : H->max;
+    }
+    return H->max;
+}
+
+// start profiling with empty histograms, or stop
+void prof_toggle(void)
+{
+    if (!prof.enabled)
+        memset(prof.hists, 0, sizeof(prof.hists));
+    prof.enabled = !prof.enabled;
+}
+
+const char *prof_name(const int timer)
+{
+    return names[timer];
+}
+
+void prof_dump(FILE *fp)
+{
+    fprintf(fp, "%-14s %10s %10s %10s %10s\n", "timer", "samples", "p50 us", "p99 us", "max us");
+    for (int i = 0; i < PROF_COUNT; i++) {
+        const hist_t *H = &prof.hists[i];
+        fprintf(fp, "%-14s %10llu %10.1f %10.1f %10.1f\n", names[i], (unsigned long long)H->count,
+                (double)hist_percentile(H, 0.50) / 1e3, (double)hist_percentile(H, 0.99) / 1e3, (double)H->max / 1e3);
+    }
+}
@@ -0,0 +1,84 @@
+//======================================================================================================================
+// File Name    : prof.h
+// Description  : Lightweight hot-path timers feeding log-bucketed latency histograms. Everything is a single branch
+//                on `prof.enabled` while profiling is off, so the timers can stay in the game loop
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_PROF_H
+#define TETRIS_PROF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// MACROS //
+#define HIST_SUB_BITS       2           // each power of two is split in 4 buckets, so a bucket is within 25%
+#define HIST_BUCKETS        (40 << HIST_SUB_BITS)
+
+
+// TYPEDEFS & ENUMS //
+enum prof_timer_e {
+    PROF_INPUT = 0,                     // draining the keys of one wakeup
+    PROF_STEP,                          // one `engine_step()`
+    PROF_PLAYFIELD,                     // `update_playfield()`
+    PROF_SCOREBOARD,                    // `update_scoreboard()`
+    PROF_NEXTP,                         // `update_nextp()`
+    PROF_REFRESH,                       // the final `doupdate()`
+    PROF_FRAME,                         // a whole frame, every update and the refresh
+    PROF_LATENCY,                       // from the wakeup that read a key to the end of the frame showing it
+    PROF_JITTER,                        // how late a tick deadline woke the game up
+    PROF_COUNT,
+};
+
+typedef struct {
+    uint32_t counts[HIST_BUCKETS];
+    uint64_t count;
+    int64_t max;                        // ns
+} hist_t;
+
+typedef struct {
+    bool enabled;
+    hist_t hists[PROF_COUNT];
+} prof_t;
+extern prof_t prof;
+
+
+// PROTOTYPES //
+void hist_add(hist_t *H, int64_t ns);
+int64_t hist_percentile(const hist_t *H, double p);
+void prof_toggle(void);
+const char *prof_name(int timer);
+void prof_dump(FILE *fp);
+
+
+// FUNCTIONS //
+// monotonic ns, or 0 while profiling is off
+static inline int64_t prof_now(void)
+{
+    struct timespec ts;
+
+    if (!prof.enabled)
+        return 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// record the time since `start` under `timer` and return the current time, so calls can be chained
+static inline int64_t prof_lap(const int timer, const int64_t start)
+{
+    int64_t now;
+
+    if (!start)
+        return 0;
+    now = prof_now();
+    if (now)
+        hist_add(&prof.hists[timer], now - start);
+    return now;
+}
+
+#endif //TETRIS_PROF_H
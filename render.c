@@ -0,0 +1,62 @@
+//======================================================================================================================
+// File Name    : render.c
+// Description  : What every renderer backend shares: looking them up by name and composing the playfield
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <stdio.h>
+#include <string.h>
+#include "prof.h"
+#include "render.h"
+
+// DATA //
+static const renderer_t *renderers[] = {&render_curses, &render_ansi};
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// backend called `name`, NULL if there is none
+const renderer_t *render_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(renderers) / sizeof(renderers[0]); i++)
+        if (!strcmp(renderers[i]->name, name))
+            return renderers[i];
+    return NULL;
+}
+
+// compose the frame: dropped pieces, the ghost where the tetromino will land, then the tetromino on top
+void render_compose(frame_t frame, const engine_t *game)
+{
+    const tetromino_t *tet = &game->tetromino;
+    const int ghost_y = tet->y + engine_drop_distance(game);
+    const uint16_t bm = tet->bitmap;
+    int x, y;
+
+    memset(frame[0], 0, sizeof(frame[0]));
+    memcpy(frame[1], game->colors[PF_BUFF_SIZE+1], sizeof(frame_t) - sizeof(frame[0]));
+    for (int i = 0; i < 16; i++) {
+        x = (i % 4) + tet->x;
+        y = (i / 4) + ghost_y - PF_BUFF_SIZE;
+
+        if (((bm >> (15-i)) & 1) && y > 0 && y < PLAYFIELD_HEIGHT && x >= 0 && x < PF_W)
+            frame[y][x] = tet->shape | GHOST_CELL;
+    }
+    for (int i = 0; i < 16; i++) {
+        x = (i % 4) + tet->x;
+        y = (i / 4) + tet->y - PF_BUFF_SIZE;
+
+        if (((bm >> (15-i)) & 1) && y >= 0 && y < PLAYFIELD_HEIGHT && x >= 0 && x < PF_W)
+            frame[y][x] = tet->shape;
+    }
+}
+
+// one line of the profiler overlay, under PROF_TITLE
+void render_prof_row(char *buf, const size_t size, const int timer)
+{
+    const hist_t *H = &prof.hists[timer];
+
+    snprintf(buf, size, "%-13s%8.1f %8.1f %8.1f", prof_name(timer), (double)hist_percentile(H, 0.50) / 1e3,
+             (double)hist_percentile(H, 0.99) / 1e3, (double)H->max / 1e3);
+}
@@ -0,0 +1,76 @@
+//======================================================================================================================
+// File Name    : render.h
+// Description  : Interface between the game loop and whatever draws it. A backend owns the terminal output between
+//                `init()` and `close()` and draws frames of a game, input.h reads the keys
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_RENDER_H
+#define TETRIS_RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+// UI, shared by every backend so they draw the same screen
+#define PRINT_BLOCK         "█"
+#define PRINT_GHOST         "░"
+#define PRINT_BUFFER        "▀"
+#define GHOST_CELL          0x80        // frame cell flag: the landing spot of the current tetromino
+#define X_SCALE             2
+#define GUTTER_SPACE        (1*X_SCALE)
+// PLAYFIELD UI
+#define PF_PADDING          2
+#define PLAYFIELD_WIDTH     (PF_W*X_SCALE)
+#define PLAYFIELD_X         2
+#define PLAYFIELD_Y         1
+// SCOREBOARD UI
+#define SB_PADDING          2
+#define SCOREBOARD_HEIGHT   9
+#define SCOREBOARD_WIDTH    (9*X_SCALE)
+#define SCOREBOARD_X        (PLAYFIELD_WIDTH+PF_PADDING+SB_PADDING+GUTTER_SPACE)
+#define SCOREBOARD_Y        1
+// NEXT PIECE UI
+#define NP_PADDING          2
+#define NEXTP_HEIGHT        9
+#define NEXTP_WIDTH         (9*X_SCALE)
+#define NEXTP_X             (PLAYFIELD_WIDTH+PF_PADDING+NP_PADDING+GUTTER_SPACE)
+#define NEXTP_Y             (SCOREBOARD_HEIGHT+SCOREBOARD_Y+NP_PADDING)
+// PROFILER UI
+#define PROF_HEIGHT         (PROF_COUNT+2)
+#define PROF_WIDTH          42
+#define PROF_X              (SCOREBOARD_X+SCOREBOARD_WIDTH+SB_PADDING+GUTTER_SPACE)
+#define PROF_Y              1
+#define PROF_REDRAW_TICKS   30          // the overlay is redrawn at most twice a second, it is not free to draw
+#define PROF_TITLE          " us        p50      p99      max "
+
+
+// TYPEDEFS //
+// the visible playfield: shape in each cell (| GHOST_CELL), row 0 is the buffer strip, it only shows a peeking tetromino
+typedef uint8_t frame_t[PLAYFIELD_HEIGHT][PF_W];
+
+typedef struct {
+    const char *name;
+    void (*init)(void);                                 // take over the terminal
+    void (*reset)(void);                                // draw what never changes, the next frame redraws every field
+    void (*draw)(const engine_t *game);                 // draw what changed since the last frame, as one update
+    void (*game_over)(const char *art, const char *status);
+    void (*close)(void);                                // hand the terminal back
+} renderer_t;
+
+
+// DATA //
+extern const renderer_t render_curses;      // ncurses windows, see render_curses.c
+extern const renderer_t render_ansi;        // escape sequences in a buffer, one write() a frame, see render_ansi.c
+
+
+// PROTOTYPES //
+const renderer_t *render_find(const char *name);
+void render_compose(frame_t frame, const engine_t *game);
+void render_prof_row(char *buf, size_t size, int timer);
+
+#endif //TETRIS_RENDER_H
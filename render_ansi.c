@@ -0,0 +1,377 @@
+//======================================================================================================================
+// File Name    : render_ansi.c
+// Description  : The direct renderer: a frame is composed as ANSI escape sequences into a preallocated buffer, with
+//                the cursor and colors tracked so only what changed is sent, then written out with a single write()
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "pieces.h"
+#include "prof.h"
+#include "render.h"
+
+// MACROS //
+#define OUT_SIZE            (64*1024)   // a full redraw is about 8 KiB
+#define CSI                 "\x1b["
+#define PUT(s)              put((s), sizeof(s) - 1)
+#define DEFAULT_COL         (-1)        // the terminal's own color
+#define WHITE_COL           7
+#define BLACK_COL           0
+
+
+// PROTOTYPES //
+static void update_scoreboard(const int score, const int lines, const int level);
+static void update_nextp(const shapes_t shape);
+static void update_playfield(const frame_t frame);
+static void update_prof(uint64_t tick);
+
+// ANSI color of each shape, see `init_colors()` in render_curses.c
+static const int shape_col[BAG_SIZE + 1] = {
+    [I_tet] = 6,    // cyan
+    [O_tet] = 3,    // yellow
+    [T_tet] = 5,    // magenta, purple
+    [S_tet] = 2,    // green
+    [Z_tet] = 1,    // red
+    [J_tet] = 4,    // blue
+    [L_tet] = 7,    // white, orange
+};
+
+// bytes of the frame being composed, and the terminal state once they are written
+static struct {
+    char buf[OUT_SIZE];
+    size_t len;
+    int y, x;                               // cursor, -1 when unknown
+    int color;                              // colors set by the last SGR, -1 when unknown
+} out;
+
+// what the last frame left on screen
+static struct {
+    frame_t cells;
+    int score;
+    int lines;
+    int level;
+    shapes_t next;
+    bool prof;                              // the overlay is showing
+    uint64_t prof_tick;                     // tick of the last overlay redraw
+} drawn;
+
+
+// HELPER FUNCTIONS //
+static void put(const char *s, const size_t n)
+{
+    if (out.len + n > sizeof(out.buf))
+        return;
+    memcpy(out.buf + out.len, s, n);
+    out.len += n;
+}
+
+static void put_int(unsigned v)
+{
+    char digits[10];
+    int n = 0;
+
+    do {
+        digits[sizeof(digits) - ++n] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    put(digits + sizeof(digits) - n, (size_t)n);
+}
+
+// move the cursor to screen row `y` column `x`, both from 0, unless it is already there
+static void move(const int y, const int x)
+{
+    if (y == out.y && x == out.x)
+        return;
+    PUT(CSI);
+    put_int((unsigned)y + 1);
+    PUT(";");
+    put_int((unsigned)x + 1);
+    PUT("H");
+    out.y = y;
+    out.x = x;
+}
+
+// set the colors of the text that follows, DEFAULT_COL for the terminal's own
+static void color(const int fg, const int bg)
+{
+    const int c = (fg + 1) | (bg + 1) << 4;
+
+    if (c == out.color)
+        return;
+    PUT(CSI "0");
+    if (fg != DEFAULT_COL) {
+        PUT(";3");
+        put_int((unsigned)fg);
+    }
+    if (bg != DEFAULT_COL) {
+        PUT(";4");
+        put_int((unsigned)bg);
+    }
+    PUT("m");
+    out.color = c;
+}
+
+// text at the cursor, `cols` terminal columns wide
+static void text(const char *s, const int cols)
+{
+    put(s, strlen(s));
+    out.x += cols;
+}
+
+static void text_at(const int y, const int x, const char *s)
+{
+    move(y, x);
+    text(s, (int)strlen(s));
+}
+
+// a box drawn like the ncurses `box()`, with row `sep` drawn as a separator, -1 for none
+static void box(const int y, const int x, const int h, const int w, const int sep)
+{
+    color(WHITE_COL, BLACK_COL);
+    move(y, x);
+    text("┌", 1);
+    for (int i = 2; i < w; i++)
+        text("─", 1);
+    text("┐", 1);
+    for (int i = 1; i < h - 1; i++) {
+        move(y + i, x);
+        text(i == sep ? "├" : "│", 1);
+        for (int j = 2; j < w; j++)
+            text(i == sep ? "─" : " ", 1);
+        text(i == sep ? "┤" : "│", 1);
+    }
+    move(y + h - 1, x);
+    text("└", 1);
+    for (int i = 2; i < w; i++)
+        text("─", 1);
+    text("┘", 1);
+}
+
+// send the composed frame, in a single write() unless the terminal takes it in parts
+static void flush(void)
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < out.len) {
+        n = write(STDOUT_FILENO, out.buf + done, out.len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+    out.len = 0;
+}
+
+
+// UPDATES //-----------------------------------------------------------------------------------------------------------
+// Each update compares against what the last frame left on screen and queues only the cells and fields that differ.
+// `ansi_draw()` then writes the whole frame at once
+static void ansi_draw(const engine_t *game)
+{
+    frame_t frame;
+    int64_t t = prof_now();
+
+    render_compose(frame, game);
+    update_playfield(frame);
+    t = prof_lap(PROF_PLAYFIELD, t);
+    update_scoreboard(game->score, game->lines, game->level);
+    t = prof_lap(PROF_SCOREBOARD, t);
+    update_nextp(game->next_shape);
+    prof_lap(PROF_NEXTP, t);
+    update_prof(game->tick);
+    t = prof_now();
+    flush();
+    prof_lap(PROF_REFRESH, t);
+}
+
+// latency overlay, blanked once the profiler is turned off
+static void update_prof(const uint64_t tick)
+{
+    char row[PROF_WIDTH];
+
+    if (prof.enabled == drawn.prof && (!prof.enabled || tick - drawn.prof_tick < PROF_REDRAW_TICKS))
+        return;
+
+    drawn.prof = prof.enabled;
+    drawn.prof_tick = tick;
+    if (!prof.enabled) {
+        color(DEFAULT_COL, DEFAULT_COL);
+        for (int i = 0; i < PROF_HEIGHT; i++) {
+            move(PROF_Y + i, PROF_X);
+            PUT(CSI);
+            put_int(PROF_WIDTH);
+            PUT("X");                    // erase characters, the cursor stays
+        }
+        return;
+    }
+
+    box(PROF_Y, PROF_X, PROF_HEIGHT, PROF_WIDTH, -1);
+    text_at(PROF_Y, PROF_X + 2, PROF_TITLE);
+    for (int i = 0; i < PROF_COUNT; i++) {
+        render_prof_row(row, sizeof(row), i);
+        text_at(PROF_Y + i + 1, PROF_X + 2, row);
+    }
+}
+
+static void update_scoreboard(const int score, const int lines, const int level)
+{
+    char field[16];
+
+    if (score == drawn.score && lines == drawn.lines && level == drawn.level)
+        return;
+
+    color(WHITE_COL, BLACK_COL);
+    if (score != drawn.score) {
+        snprintf(field, sizeof(field), "%9d", score);
+        text_at(SCOREBOARD_Y + 4, SCOREBOARD_X + 9, field);
+    }
+    if (lines != drawn.lines) {
+        snprintf(field, sizeof(field), "%9d", lines);
+        text_at(SCOREBOARD_Y + 6, SCOREBOARD_X + 9, field);
+    }
+    if (level != drawn.level) {
+        snprintf(field, sizeof(field), "%9d", level);
+        text_at(SCOREBOARD_Y + 8, SCOREBOARD_X + 9, field);
+    }
+
+    drawn.score = score;
+    drawn.lines = lines;
+    drawn.level = level;
+}
+
+// same spot as the ncurses preview: the bitmap at (3, 4) of the panel, one column right unless it is I or O
+static void update_nextp(const shapes_t shape)
+{
+    const uint16_t bm = PIECE(shape, 0)->bitmap;
+    const int xoff = (shape == I_tet || shape == O_tet) ? 0 : 1;
+
+    if (shape == drawn.next)
+        return;
+
+    // clear the old preview inside the border and below the title
+    color(WHITE_COL, BLACK_COL);
+    for (int i = 3; i < NEXTP_HEIGHT + NP_PADDING - 1; i++) {
+        move(NEXTP_Y + i, NEXTP_X + 1);
+        for (int j = 0; j < NEXTP_WIDTH; j++)
+            text(" ", 1);
+    }
+    color(shape_col[shape], BLACK_COL);
+    for (int i = 0; i < 16; i++)
+        if ((bm >> (15-i)) & 1) {
+            move(NEXTP_Y + (i / 4) + 4 + 1, NEXTP_X + ((i % 4) + 3)*X_SCALE + xoff);
+            text(PRINT_BLOCK PRINT_BLOCK, 2);
+        }
+
+    drawn.next = shape;
+}
+
+static void update_playfield(const frame_t frame)
+{
+    // draw the cells that differ from the last frame
+    for (int i = 0; i < PLAYFIELD_HEIGHT; i++) {
+        for (int j = 0; j < PF_W; j++) {
+            uint8_t c = frame[i][j];
+
+            if (c == drawn.cells[i][j])
+                continue;
+            move(PLAYFIELD_Y + i, PLAYFIELD_X + (j*X_SCALE) + 1);
+            if (i == 0) {
+                color(WHITE_COL, c ? shape_col[c] : BLACK_COL);
+                text(PRINT_BUFFER PRINT_BUFFER, 2);
+            } else if (c & GHOST_CELL) {
+                color(shape_col[c & ~GHOST_CELL], BLACK_COL);
+                text(PRINT_GHOST PRINT_GHOST, 2);
+            } else if (c) {
+                color(shape_col[c], BLACK_COL);
+                text(PRINT_BLOCK PRINT_BLOCK, 2);
+            } else {
+                color(DEFAULT_COL, DEFAULT_COL);
+                text("  ", 2);
+            }
+            drawn.cells[i][j] = c;
+        }
+    }
+}
+
+
+// INIT //--------------------------------------------------------------------------------------------------------------
+// clear the screen, draw everything that never changes and forget the last frame, so the next updates draw every field
+static void ansi_reset(void)
+{
+    out.len = 0;
+    out.color = -1;
+    PUT(CSI "0m" CSI "2J");
+    out.y = out.x = -1;
+
+    box(PLAYFIELD_Y, PLAYFIELD_X, PLAYFIELD_HEIGHT + 1, PLAYFIELD_WIDTH + PF_PADDING, -1);
+    move(PLAYFIELD_Y, PLAYFIELD_X);
+    text("│", 1);
+    color(WHITE_COL, BLACK_COL);
+    for (int i = 0; i < PLAYFIELD_WIDTH; i++)
+        text(PRINT_BUFFER, 1);
+    text("│", 1);
+    color(DEFAULT_COL, DEFAULT_COL);
+    for (int i = 1; i < PLAYFIELD_HEIGHT; i++) {
+        move(PLAYFIELD_Y + i, PLAYFIELD_X + 1);
+        for (int j = 0; j < PLAYFIELD_WIDTH; j++)
+            text(" ", 1);
+    }
+
+    box(SCOREBOARD_Y, SCOREBOARD_X, SCOREBOARD_HEIGHT + SB_PADDING, SCOREBOARD_WIDTH + SB_PADDING, 2);
+    text_at(SCOREBOARD_Y + 1, SCOREBOARD_X + 4, "SCORE  BOARD");
+    text_at(SCOREBOARD_Y + 4, SCOREBOARD_X + 2, "Score:");
+    text_at(SCOREBOARD_Y + 6, SCOREBOARD_X + 2, "Lines:");
+    text_at(SCOREBOARD_Y + 8, SCOREBOARD_X + 2, "Level:");
+
+    box(NEXTP_Y, NEXTP_X, NEXTP_HEIGHT + NP_PADDING, NEXTP_WIDTH + NP_PADDING, 2);
+    text_at(NEXTP_Y + 1, NEXTP_X + 5, "NEXT PIECE");
+    flush();
+
+    memset(drawn.cells, 0, sizeof(drawn.cells));
+    drawn.score = drawn.lines = drawn.level = -1;
+    drawn.next = 0;
+    drawn.prof = false;
+}
+
+// switch to the alternate screen with the cursor hidden
+static void ansi_init(void)
+{
+    out.y = out.x = out.color = -1;
+    PUT(CSI "?1049h" CSI "?25l");
+    flush();
+}
+
+
+// API //---------------------------------------------------------------------------------------------------------------
+static void ansi_game_over(const char *art, const char *status)
+{
+    struct winsize ws;
+    const int rows = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row ? ws.ws_row : 24;
+
+    color(shape_col[O_tet], BLACK_COL);
+    move(5, 0);
+    put(art, strlen(art));                  // the terminal turns each '\n' into a new line at column 0
+    color(DEFAULT_COL, DEFAULT_COL);
+    out.y = out.x = -1;
+    text_at(rows - 1, 0, status);
+    flush();
+}
+
+static void ansi_close(void)
+{
+    PUT(CSI "0m" CSI "?25h" CSI "?1049l");
+    flush();
+}
+
+const renderer_t render_ansi = {.name="ansi", .init=&ansi_init, .reset=&ansi_reset, .draw=&ansi_draw,
+                                .game_over=&ansi_game_over, .close=&ansi_close};
@@ -0,0 +1,355 @@
+//======================================================================================================================
+// File Name    : render_curses.c
+// Description  : The ncurses renderer: a window per panel, each update queues its window with wnoutrefresh() and the
+//                frame goes out with a single doupdate()
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <ncurses.h>
+#include "pieces.h"
+#include "prof.h"
+#include "render.h"
+
+// TYPEDEFS, PROTOTYPES, STRUCTS, & ENUMS //
+enum colors_e {
+    tI_c = I_tet,
+    tO_c = O_tet,
+    tT_c = T_tet,
+    tS_c = S_tet,
+    tZ_c = Z_tet,
+    tJ_c = J_tet,
+    tL_c = L_tet,
+    bg_c,
+    borders_c,
+    buffer_c,
+    buffI_c,
+    buffO_c,
+    buffT_c,
+    buffS_c,
+    buffZ_c,
+    buffJ_c,
+    buffL_c,
+};
+
+static void update_scoreboard(const int score, const int lines, const int level);
+static void update_nextp(const shapes_t shape);
+static void update_playfield(const frame_t frame);
+static void update_prof(uint64_t tick);
+
+static struct {
+    WINDOW *playfield;
+    WINDOW *scoreboard;
+    WINDOW *nextp;
+    WINDOW *prof;                           // latency overlay, blank unless the profiler is on
+} windows;
+
+// what the last frame left on screen
+static struct {
+    frame_t cells;
+    int score;
+    int lines;
+    int level;
+    shapes_t next;
+    bool prof;                              // the overlay is showing
+    uint64_t prof_tick;                     // tick of the last overlay redraw
+} drawn;
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// draw a tetromino on a window
+static void draw_tetromino(WINDOW *win, const tetromino_t *tet, const int yoff, const int xoff)
+{
+    int x, y;
+    uint16_t bm = tet->bitmap;
+
+    wattron(win, COLOR_PAIR(tet->shape));
+    for (int i = 0; i < 16; i++) {
+        x = (i % 4) + tet->x;
+        y = (i / 4) + tet->y;
+
+        if ((bm >> (15-i)) & 1) {
+            mvwprintw(win, y+yoff, (x*X_SCALE)+xoff, PRINT_BLOCK);
+            mvwprintw(win, y+yoff, (x*X_SCALE)+xoff+1, PRINT_BLOCK);
+        }
+    }
+    wattroff(win, COLOR_PAIR(tet->shape));
+}
+
+
+// UPDATES //-----------------------------------------------------------------------------------------------------------
+// Each update compares against what the last frame left on screen, draws only the cells and fields that differ and
+// queues its window with wnoutrefresh(). `curses_draw()` then sends the whole frame with a single doupdate()
+static void curses_draw(const engine_t *game)
+{
+    frame_t frame;
+    int64_t t = prof_now();
+
+    render_compose(frame, game);
+    update_playfield(frame);
+    t = prof_lap(PROF_PLAYFIELD, t);
+    update_scoreboard(game->score, game->lines, game->level);
+    t = prof_lap(PROF_SCOREBOARD, t);
+    update_nextp(game->next_shape);
+    prof_lap(PROF_NEXTP, t);
+    update_prof(game->tick);
+    t = prof_now();
+    doupdate();
+    prof_lap(PROF_REFRESH, t);
+}
+
+// latency overlay, blanked once the profiler is turned off
+static void update_prof(const uint64_t tick)
+{
+    WINDOW *win = windows.prof;
+    char row[PROF_WIDTH];
+
+    if (prof.enabled == drawn.prof && (!prof.enabled || tick - drawn.prof_tick < PROF_REDRAW_TICKS))
+        return;
+
+    drawn.prof = prof.enabled;
+    drawn.prof_tick = tick;
+    werase(win);
+    if (prof.enabled) {
+        wattron(win, COLOR_PAIR(borders_c));
+        box(win, 0, 0);
+        mvwprintw(win, 0, 2, PROF_TITLE);
+        for (int i = 0; i < PROF_COUNT; i++) {
+            render_prof_row(row, sizeof(row), i);
+            mvwprintw(win, i + 1, 2, "%s", row);
+        }
+        wattroff(win, COLOR_PAIR(borders_c));
+    }
+    wnoutrefresh(win);
+}
+
+static void update_scoreboard(const int score, const int lines, const int level)
+{
+    WINDOW *win = windows.scoreboard;
+
+    if (score == drawn.score && lines == drawn.lines && level == drawn.level)
+        return;
+
+    wattron(win, COLOR_PAIR(borders_c));
+    if (score != drawn.score)
+        mvwprintw(win, 4, 9, "%9d", score);
+    if (lines != drawn.lines)
+        mvwprintw(win, 6, 9, "%9d", lines);
+    if (level != drawn.level)
+        mvwprintw(win, 8, 9, "%9d", level);
+    wattroff(win, COLOR_PAIR(borders_c));
+
+    drawn.score = score;
+    drawn.lines = lines;
+    drawn.level = level;
+    wnoutrefresh(win);
+}
+
+static void update_nextp(const shapes_t shape)
+{
+    int xoff, yoff;
+    WINDOW *win = windows.nextp;
+    tetromino_t T = {.shape=shape, .rotation=0, .bitmap=0, .falling=false};
+
+    if (shape == drawn.next)
+        return;
+
+    switch (T.shape) {
+        case I_tet:
+        case O_tet:
+            T.x = 3;
+            T.y = 4;
+            xoff = 0;
+            yoff = 1;
+            break;
+        case T_tet:
+        case S_tet:
+        case Z_tet:
+        case J_tet:
+        case L_tet:
+            T.x = 3;
+            T.y = 4;
+            xoff = 1;
+            yoff = 1;
+            break;
+
+        default:
+            _exit(1);
+    }
+    T.bitmap = PIECE(T.shape, T.rotation)->bitmap;
+
+    // clear the old preview inside the border and below the title
+    for (int i = 3; i < getmaxy(win) - 1; i++)
+        mvwhline(win, i, 1, ' ', getmaxx(win) - 2);
+    draw_tetromino(win, &T, yoff, xoff);
+
+    drawn.next = shape;
+    wnoutrefresh(win);
+}
+
+static void update_playfield(const frame_t frame)
+{
+    WINDOW *win = windows.playfield;
+    bool changed = false;
+
+    // draw the cells that differ from the last frame
+    for (int i = 0; i < PLAYFIELD_HEIGHT; i++) {
+        for (int j = 0; j < PF_W; j++) {
+            uint8_t c = frame[i][j];
+
+            if (c == drawn.cells[i][j])
+                continue;
+            if (i == 0) {
+                wattron(win, COLOR_PAIR(c ? buffer_c+c : buffer_c));
+                mvwprintw(win, 0, (j*X_SCALE)+1, PRINT_BUFFER PRINT_BUFFER);
+                wattroff(win, COLOR_PAIR(c ? buffer_c+c : buffer_c));
+            } else if (c & GHOST_CELL) {
+                wattron(win, COLOR_PAIR(c & ~GHOST_CELL));
+                mvwprintw(win, i, (j*X_SCALE)+1, PRINT_GHOST PRINT_GHOST);
+                wattroff(win, COLOR_PAIR(c & ~GHOST_CELL));
+            } else if (c) {
+                wattron(win, COLOR_PAIR(c));
+                mvwprintw(win, i, (j*X_SCALE)+1, PRINT_BLOCK PRINT_BLOCK);
+                wattroff(win, COLOR_PAIR(c));
+            } else {
+                mvwprintw(win, i, (j*X_SCALE)+1, "  ");
+            }
+            drawn.cells[i][j] = c;
+            changed = true;
+        }
+    }
+
+    if (changed)
+        wnoutrefresh(win);
+}
+
+
+// INIT //--------------------------------------------------------------------------------------------------------------
+static void init_windows(void)
+{
+    windows.playfield = newwin(PLAYFIELD_HEIGHT+1, PLAYFIELD_WIDTH + PF_PADDING, PLAYFIELD_Y, PLAYFIELD_X);
+    windows.scoreboard = newwin(SCOREBOARD_HEIGHT + SB_PADDING, SCOREBOARD_WIDTH + SB_PADDING, SCOREBOARD_Y, SCOREBOARD_X);
+    windows.nextp = newwin(NEXTP_HEIGHT + NP_PADDING, NEXTP_WIDTH + NP_PADDING, NEXTP_Y, NEXTP_X);
+    windows.prof = newwin(PROF_HEIGHT, PROF_WIDTH, PROF_Y, PROF_X);
+}
+
+static void init_colors(void)
+{
+    enum {
+        background_col = COLOR_BLACK,
+        playfield_border_col = COLOR_WHITE,
+        buffer_col = COLOR_WHITE,
+        tI_col = COLOR_CYAN,
+        tO_col = COLOR_YELLOW,
+        tT_col = COLOR_MAGENTA,    // purple
+        tS_col = COLOR_GREEN,
+        tZ_col = COLOR_RED,
+        tJ_col = COLOR_BLUE,
+        tL_col = COLOR_WHITE,      // orange
+    };
+
+    // main colors
+    start_color();
+    init_pair(bg_c, background_col, background_col);
+    init_pair(borders_c, playfield_border_col, background_col);
+    init_pair(buffer_c, buffer_col, background_col);
+
+    // tetromino colors
+    init_pair(tI_c, tI_col, background_col);
+    init_pair(tO_c, tO_col, background_col);
+    init_pair(tT_c, tT_col, background_col);
+    init_pair(tS_c, tS_col, background_col);
+    init_pair(tZ_c, tZ_col, background_col);
+    init_pair(tJ_c, tJ_col, background_col);
+    init_pair(tL_c, tL_col, background_col);
+
+    // playfield buffer color when a tetromino is peeking
+    init_pair(buffI_c, buffer_col, tI_col);
+    init_pair(buffO_c, buffer_col, tO_col);
+    init_pair(buffT_c, buffer_col, tT_col);
+    init_pair(buffS_c, buffer_col, tS_col);
+    init_pair(buffZ_c, buffer_col, tZ_col);
+    init_pair(buffJ_c, buffer_col, tJ_col);
+    init_pair(buffL_c, buffer_col, tL_col);
+}
+
+// draw everything that never changes and forget the last frame, so the next updates draw every field
+static void curses_reset(void)
+{
+    WINDOW *pf = windows.playfield;
+    WINDOW *sb = windows.scoreboard;
+    WINDOW *np = windows.nextp;
+
+    wnoutrefresh(stdscr);       // flush the untouched stdscr now, its first refresh would blank the windows drawn below
+    werase(pf);
+    wattron(pf, COLOR_PAIR(borders_c));
+    box(pf, 0, 0);
+    mvwprintw(pf, 0, 0, "│");
+    mvwprintw(pf, 0, PLAYFIELD_WIDTH + 1, "│");
+    //for (int i = 0; i < PLAYFIELD_HEIGHT; i++)
+    //    mvwprintw(pf,PLAYFIELD_HEIGHT-i-1, PF_W*X_SCALE-4, "%d", i+1);
+    wattroff(pf, COLOR_PAIR(borders_c));
+    wattron(pf, COLOR_PAIR(buffer_c));
+    for (int i = 0; i < PLAYFIELD_WIDTH; i++)
+        mvwprintw(pf, 0, i + 1, PRINT_BUFFER);
+    wattroff(pf, COLOR_PAIR(buffer_c));
+
+    werase(sb);
+    wattron(sb, COLOR_PAIR(borders_c));
+    box(sb, 0, 0);
+    mvwprintw(sb, 1, 4, "SCORE  BOARD");
+    mvwprintw(sb, 2, 0, "├──────────────────┤");
+    mvwprintw(sb, 4, 2, "Score:");
+    mvwprintw(sb, 6, 2, "Lines:");
+    mvwprintw(sb, 8, 2, "Level:");
+    wattroff(sb, COLOR_PAIR(borders_c));
+
+    werase(np);
+    wattron(np, COLOR_PAIR(borders_c));
+    box(np, 0, 0);
+    mvwprintw(np, 1, 5, "NEXT PIECE");
+    mvwprintw(np, 2, 0, "├──────────────────┤");
+    wattroff(np, COLOR_PAIR(borders_c));
+
+    wnoutrefresh(pf);
+    wnoutrefresh(sb);
+    wnoutrefresh(np);
+
+    memset(drawn.cells, 0, sizeof(drawn.cells));
+    drawn.score = drawn.lines = drawn.level = -1;
+    drawn.next = 0;
+    drawn.prof = false;
+}
+
+static void curses_init(void)
+{
+    initscr();                  // Init ncurses
+    init_colors();              // Init color pairs for ncurses
+    init_windows();             // Init ncurses windows
+
+    curs_set(0);                // cursor won't blink
+}
+
+
+// API //---------------------------------------------------------------------------------------------------------------
+static void curses_game_over(const char *art, const char *status)
+{
+    attron(COLOR_PAIR(O_tet));
+    mvprintw(5, 0, "%s", art);
+    attroff(COLOR_PAIR(O_tet));
+    mvprintw(LINES-1, 0, "%s", status);
+    refresh();
+}
+
+static void curses_close(void)
+{
+    endwin();
+}
+
+const renderer_t render_curses = {.name="curses", .init=&curses_init, .reset=&curses_reset, .draw=&curses_draw,
+                                  .game_over=&curses_game_over, .close=&curses_close};
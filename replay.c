@@ -0,0 +1,183 @@
+//======================================================================================================================
+// File Name    : replay.c
+// Description  : Replay recorder and headless player
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+// MACROS //
+#define FNV_OFFSET          1469598103934665603ULL
+#define FNV_PRIME           1099511628211ULL
+
+_Static_assert(IN_QUIT < (1 << REPLAY_INPUT_BITS), "every input must fit next to the tick delta");
+
+
+// HELPER FUNCTIONS //
+static void put_varint(FILE *fp, uint64_t v)
+{
+    while (v >= 0x80) {
+        fputc((int)(v & 0x7F) | 0x80, fp);
+        v >>= 7;
+    }
+    fputc((int)v, fp);
+}
+
+// returns 0 on success, -1 on EOF or a varint longer than 64 bits
+static int get_varint(FILE *fp, uint64_t *v)
+{
+    int c;
+
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if ((c = fgetc(fp)) == EOF)
+            return -1;
+        *v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return 0;
+    }
+    return -1;
+}
+
+
+// RECORDER //----------------------------------------------------------------------------------------------------------
+// start a replay file for a game seeded with `seed`, returns 0 on success
+int replay_open(replay_writer_t *W, const char *path, const uint32_t seed)
+{
+    W->last_tick = 0;
+    if (!(W->fp = fopen(path, "wb")))
+        return -1;
+
+    fwrite(REPLAY_MAGIC, 1, 4, W->fp);
+    put_varint(W->fp, REPLAY_FORMAT);
+    put_varint(W->fp, RULESET_VERSION);
+    put_varint(W->fp, PF_W);
+    put_varint(W->fp, BOARD_H);
+    put_varint(W->fp, seed);
+    return 0;
+}
+
+// append an input applied on engine tick `tick`, after that tick's IN_TICK step
+void replay_record(replay_writer_t *W, const uint64_t tick, const input_t in)
+{
+    if (!W->fp || in == IN_NONE || in == IN_TICK)
+        return;
+
+    put_varint(W->fp, ((tick - W->last_tick) << REPLAY_INPUT_BITS) | (uint64_t)in);
+    W->last_tick = tick;
+}
+
+// write the end marker and the final state of the game, returns 0 if everything reached the file
+int replay_close(replay_writer_t *W, const engine_t *E)
+{
+    uint64_t hash = replay_board_hash(E);
+    int err;
+
+    if (!W->fp)
+        return -1;
+
+    put_varint(W->fp, ((E->tick - W->last_tick) << REPLAY_INPUT_BITS) | IN_NONE);
+    put_varint(W->fp, (uint64_t)E->score);
+    put_varint(W->fp, (uint64_t)E->lines);
+    for (int i = 0; i < 8; i++)
+        fputc((int)(hash >> (8*i)) & 0xFF, W->fp);
+
+    err = ferror(W->fp);
+    err |= fclose(W->fp);
+    W->fp = NULL;
+    return err ? -1 : 0;
+}
+
+
+// PLAYER //------------------------------------------------------------------------------------------------------------
+// run the engine up to `tick`, stopping early if the game ends
+static void run_to(engine_t *E, const uint64_t tick, replay_result_t *R)
+{
+    while (E->running && E->tick < tick) {
+        if (engine_step(E, IN_TICK) & EV_LOCKED)
+            R->pieces++;
+        R->ticks++;
+    }
+}
+
+// re-simulate a replay as fast as possible and compare the result with the one recorded, returns `replay_status_e`
+int replay_play(const char *path, replay_result_t *R)
+{
+    engine_t E;
+    char magic[4];
+    uint64_t v, tick = 0, format, ruleset, width = 10, height = 20, seed, score, lines;
+    int status = REPLAY_ERR_FORMAT;
+    FILE *fp;
+
+    memset(R, 0, sizeof(*R));
+    if (!(fp = fopen(path, "rb")))
+        return REPLAY_ERR_IO;
+
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+        get_varint(fp, &format) || format < 1 || format > REPLAY_FORMAT || get_varint(fp, &ruleset) ||
+        (format >= 2 && (get_varint(fp, &width) || get_varint(fp, &height))) || get_varint(fp, &seed))
+        goto out;
+    R->ruleset = (uint32_t)ruleset;
+    R->seed = (uint32_t)seed;
+    if (ruleset != RULESET_VERSION || width != PF_W || height != BOARD_H)
+        goto out;
+
+    engine_init(&E, R->seed);
+
+    // inputs, each one after every tick up to its own has run
+    for (;;) {
+        if (get_varint(fp, &v))
+            goto out;
+        tick += v >> REPLAY_INPUT_BITS;
+        run_to(&E, tick, R);
+        if ((v & ((1u << REPLAY_INPUT_BITS) - 1)) == IN_NONE)
+            break;
+        if (E.running) {
+            if (engine_step(&E, (input_t)(v & ((1u << REPLAY_INPUT_BITS) - 1))) & EV_LOCKED)
+                R->pieces++;
+            R->events++;
+        }
+    }
+
+    // recorded result
+    if (get_varint(fp, &score) || get_varint(fp, &lines))
+        goto out;
+    R->expected.score = (int)score;
+    R->expected.lines = (int)lines;
+    for (int i = 0; i < 8; i++) {
+        int c = fgetc(fp);
+        if (c == EOF)
+            goto out;
+        R->expected.hash |= (uint64_t)c << (8*i);
+    }
+
+    R->actual.score = E.score;
+    R->actual.lines = E.lines;
+    R->level = E.level;
+    R->actual.hash = replay_board_hash(&E);
+    status = (R->actual.score == R->expected.score && R->actual.lines == R->expected.lines &&
+              R->actual.hash == R->expected.hash) ? REPLAY_OK : REPLAY_MISMATCH;
+
+out:
+    fclose(fp);
+    return status;
+}
+
+// FNV-1a over the occupancy and colors of the playfield
+uint64_t replay_board_hash(const engine_t *E)
+{
+    uint64_t h = FNV_OFFSET;
+
+    for (int y = 0; y < PF_H; y++) {
+        for (int b = 0; b < (int)sizeof(row_t); b++)
+            h = (h ^ ((E->rows[y] >> (8 * b)) & 0xFF)) * FNV_PRIME;
+        for (int x = 0; x < PF_W; x++)
+            h = (h ^ E->colors[y][x]) * FNV_PRIME;
+    }
+    return h;
+}
@@ -0,0 +1,65 @@
+//======================================================================================================================
+// File Name    : replay.h
+// Description  : Compact deterministic replays: the seed, the ruleset version and every (tick, input) pair of a game,
+//                followed by the final score, lines and board hash so a re-simulation can be checked
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "engine.h"
+
+// MACROS //
+// File layout, every integer is an unsigned LEB128 varint unless noted
+//   "TTRP" format ruleset width height seed
+//               format 1 files have no width and height, they were all played on the 10x20 board
+//   event*      (ticks since the previous event << 4) | input, input is never IN_NONE or IN_TICK
+//   end         (ticks since the previous event << 4) | IN_NONE
+//   score lines hash      hash is 8 bytes little-endian
+#define REPLAY_MAGIC        "TTRP"
+#define REPLAY_FORMAT       2
+#define REPLAY_INPUT_BITS   4
+
+
+// TYPEDEFS //
+typedef struct {
+    FILE *fp;
+    uint64_t last_tick;                 // tick of the previous event, events are delta encoded against it
+} replay_writer_t;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t ruleset;
+    uint64_t events;                    // inputs replayed
+    uint64_t ticks;                     // ticks simulated
+    uint64_t pieces;                    // tetrominos locked
+    int level;                          // level at the end of the re-simulation
+    struct {
+        int score;
+        int lines;
+        uint64_t hash;
+    } expected, actual;
+} replay_result_t;
+
+enum replay_status_e {
+    REPLAY_OK = 0,
+    REPLAY_MISMATCH,                    // the re-simulation did not end with the recorded score, lines and board
+    REPLAY_ERR_IO,
+    REPLAY_ERR_FORMAT,                  // not a replay, truncated, or recorded with another ruleset or board
+};
+
+
+// PROTOTYPES //
+int replay_open(replay_writer_t *W, const char *path, uint32_t seed);
+void replay_record(replay_writer_t *W, uint64_t tick, input_t in);
+int replay_close(replay_writer_t *W, const engine_t *E);
+int replay_play(const char *path, replay_result_t *R);
+uint64_t replay_board_hash(const engine_t *E);
+
+#endif //TETRIS_REPLAY_H
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <time.h>
+#include "replay.h"
+
+// re-simulate every replay given on the command line as fast as possible and check its recorded result
+int main(int argc, char *argv[])
+{
+    static const char *status_str[] = {"ok", "MISMATCH", "cannot open", "bad format"};
+    struct timespec s, e;
+    replay_result_t R;
+    double secs;
+    int status, failed = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s replay-file...\n", argv[0]);
+        return 2;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &s);
+        status = replay_play(argv[i], &R);
+        clock_gettime(CLOCK_MONOTONIC, &e);
+        secs = (double)(e.tv_sec - s.tv_sec) + (double)(e.tv_nsec - s.tv_nsec) / 1e9;
+
+        printf("%s: %s seed=%u ruleset=%u score=%d/%d lines=%d/%d hash=%016llx/%016llx\n", argv[i], status_str[status],
+               R.seed, R.ruleset, R.actual.score, R.expected.score, R.actual.lines, R.expected.lines,
+               (unsigned long long)R.actual.hash, (unsigned long long)R.expected.hash);
+        if (status <= REPLAY_MISMATCH)
+            printf("    %llu ticks, %llu inputs, %llu pieces in %.3f ms (%.0f ticks/s, %.0f pieces/s)\n",
+                   (unsigned long long)R.ticks, (unsigned long long)R.events, (unsigned long long)R.pieces,
+                   secs * 1e3, secs > 0 ? (double)R.ticks / secs : 0, secs > 0 ? (double)R.pieces / secs : 0);
+        failed |= status != REPLAY_OK;
+    }
+    return failed;
+}
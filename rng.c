@@ -0,0 +1,64 @@
+//======================================================================================================================
+// File Name    : rng.c
+// Description  : PCG32 (XSH RR variant) by Melissa O'Neill, see https://www.pcg-random.org
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include "rng.h"
+
+// MACROS //
+#define PCG_MULT            6364136223846793005ULL
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// start the stream `stream` at position `seed`, any two (seed, stream) pairs give unrelated sequences
+void rng_seed(rng_t *R, const uint64_t seed, const uint64_t stream)
+{
+    R->state = 0;
+    R->inc = (stream << 1u) | 1u;
+    rng_next(R);
+    R->state += seed;
+    rng_next(R);
+}
+
+// seed `child` from two outputs of `parent`, the child stream is independent from then on
+void rng_fork(rng_t *parent, rng_t *child)
+{
+    uint64_t seed, stream;
+
+    // one draw per statement, the order of two calls in one expression is unspecified
+    seed = (uint64_t)rng_next(parent) << 32;
+    seed |= rng_next(parent);
+    stream = (uint64_t)rng_next(parent) << 32;
+    stream |= rng_next(parent);
+    rng_seed(child, seed, stream);
+}
+
+uint32_t rng_next(rng_t *R)
+{
+    uint64_t old = R->state;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+
+    R->state = old * PCG_MULT + R->inc;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// uniform in [0, bound) without modulo bias (Lemire's multiply and reject)
+uint32_t rng_below(rng_t *R, const uint32_t bound)
+{
+    uint64_t m = (uint64_t)rng_next(R) * bound;
+    uint32_t low = (uint32_t)m;
+
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (uint64_t)rng_next(R) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
@@ -0,0 +1,28 @@
+//======================================================================================================================
+// File Name    : rng.h
+// Description  : Small per-game PRNG (PCG32), so every game owns its random stream and can be reproduced from a seed
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_RNG_H
+#define TETRIS_RNG_H
+
+#include <stdint.h>
+
+// TYPEDEFS //
+typedef struct {
+    uint64_t state;
+    uint64_t inc;                       // stream selector, always odd
+} rng_t;
+
+
+// PROTOTYPES //
+void rng_seed(rng_t *R, uint64_t seed, uint64_t stream);
+void rng_fork(rng_t *parent, rng_t *child);
+uint32_t rng_next(rng_t *R);
+uint32_t rng_below(rng_t *R, uint32_t bound);
+
+#endif //TETRIS_RNG_H
@@ -0,0 +1,77 @@
+//======================================================================================================================
+// File Name    : sched.c
+// Description  : Fixed-timestep tick scheduler on CLOCK_MONOTONIC
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include "engine.h"
+#include "sched.h"
+
+// MACROS //
+#define NS_PER_SEC          1000000000LL
+#define TICK_NS             ((int64_t)TICK_US * 1000)
+
+
+// HELPER FUNCTIONS //
+static int64_t now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * NS_PER_SEC + t.tv_nsec;
+}
+
+
+// API //---------------------------------------------------------------------------------------------------------------
+// tick 0 starts now
+void sched_init(sched_t *S)
+{
+    *S = (sched_t){.origin = now_ns()};
+}
+
+// absolute monotonic time at which `ticks` more ticks will be due, remembered to measure how late the wakeup is
+struct timespec sched_deadline(sched_t *S, const int ticks)
+{
+    int64_t at;
+
+    S->planned = S->tick + (ticks > 0 ? ticks : 1);
+    at = S->origin + (int64_t)S->planned * TICK_NS;
+    return (struct timespec){.tv_sec = at / NS_PER_SEC, .tv_nsec = at % NS_PER_SEC};
+}
+
+// number of ticks the caller must run now, in order. Catch-up rule: when the planned tick was reached more than
+// SCHED_MAX_LATE ticks late (a stall, a suspended process) the surplus is dropped instead of fast-forwarding the game
+int sched_due(sched_t *S)
+{
+    int64_t now = now_ns();
+    uint64_t elapsed = (uint64_t)((now - S->origin) / TICK_NS);
+    uint64_t due;
+
+    if (elapsed < S->tick)
+        return 0;
+
+    if (elapsed >= S->planned) {
+        int64_t late = now - (S->origin + (int64_t)S->planned * TICK_NS);
+
+        S->jitter.wakeups++;
+        S->jitter.sum_ns += late;
+        S->jitter.last_ns = late;
+        if (late > S->jitter.max_ns)
+            S->jitter.max_ns = late;
+
+        if (elapsed - S->planned > SCHED_MAX_LATE) {
+            uint64_t drop = elapsed - S->planned - SCHED_MAX_LATE;
+
+            S->origin += (int64_t)drop * TICK_NS;
+            S->dropped += drop;
+            elapsed -= drop;
+        }
+    }
+
+    due = elapsed - S->tick;
+    S->tick = elapsed;
+    return (int)due;
+}
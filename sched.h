@@ -0,0 +1,42 @@
+//======================================================================================================================
+// File Name    : sched.h
+// Description  : Fixed-timestep tick scheduler on CLOCK_MONOTONIC. Tick n is due at `origin + n*TICK_US`, so the
+//                game advances at the same rate however busy the CPU is, and the same inputs on the same ticks always
+//                give the same game
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_SCHED_H
+#define TETRIS_SCHED_H
+
+#include <stdint.h>
+#include <time.h>
+
+// MACROS //
+#define SCHED_MAX_LATE      6           // ticks a wakeup may run behind before the extra ticks are dropped (100ms)
+
+
+// TYPEDEFS //
+typedef struct {
+    int64_t origin;                     // monotonic ns of tick 0, pushed forward when ticks are dropped
+    uint64_t tick;                      // ticks handed out so far
+    uint64_t planned;                   // tick the last deadline was armed for
+    uint64_t dropped;                   // ticks skipped because a wakeup was more than SCHED_MAX_LATE ticks late
+    struct {
+        uint64_t wakeups;               // deadlines that were reached
+        int64_t sum_ns;                 // total lateness of those wakeups
+        int64_t max_ns;                 // worst lateness of a single wakeup
+        int64_t last_ns;                // lateness of the latest one
+    } jitter;
+} sched_t;
+
+
+// PROTOTYPES //
+void sched_init(sched_t *S);
+struct timespec sched_deadline(sched_t *S, int ticks);
+int sched_due(sched_t *S);
+
+#endif //TETRIS_SCHED_H
@@ -0,0 +1,424 @@
+//======================================================================================================================
+// File Name    : search.c
+// Description  : Beam search over placements. The first ply places the current piece and the second the preview. Later
+//                plies cannot know the piece, so every shape the bag can still deal is tried and a board is worth the
+//                average over those shapes of its best child. The root placements are split between threads, each
+//                runs its own beam, and the answer comes from the deepest ply every thread finished within the budget
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pieces.h"
+#include "pool.h"
+#include "search.h"
+
+// MACROS //
+#define SEARCH_LOSS         (INT32_MIN / 2)                         // score of a board that ended the game
+#define SHAPE_BIT(s)        (1u << (s))
+#define ALL_SHAPES          ((uint8_t)(((1u << BAG_SIZE) - 1) << I_tet))
+
+
+// TYPEDEFS //
+// a board kept in the beam
+typedef struct {
+    engine_t state;                     // its tetromino is only the real next piece after the first ply
+    int root;                           // root placement this board descends from
+    uint8_t bag;                        // shapes the bag can still deal once the preview is used, see SHAPE_BIT
+} node_t;
+
+// a scored child, it only becomes a node if it makes the beam
+typedef struct {
+    int32_t score;
+    int parent;
+    shapes_t piece;
+    placement_t placement;
+} cand_t;
+
+typedef struct {
+    _Alignas(64) eval_batch_t batch;
+    struct {
+        int cand;
+        int32_t lines;                  // weighted lines cleared since the root, added to the cached board score
+        uint64_t key;
+    } lanes[EVAL_LANES];
+    movegen_t gen;
+    node_t *beam, *next;
+    cand_t *cands;
+    int size;                           // nodes in `beam`
+    int depth;                          // plies completed
+    struct {
+        int32_t score;
+        int root;
+    } best[SEARCH_MAX_DEPTH];           // best board after each completed ply
+    long boards;
+    long tt_hits;
+    bool timed_out;
+} worker_t;
+
+typedef struct {
+    const engine_t *root;
+    const search_opts_t *opts;
+    movegen_t *roots;                   // placements of the current piece, with paths
+    bool *usable;                       // the root placement's path fits in SEARCH_MAX_INPUTS
+    worker_t *workers;
+    int threads;
+    struct timespec deadline;
+} search_t;
+
+
+// HELPER FUNCTIONS //
+static bool expired(const search_t *S)
+{
+    struct timespec now;
+
+    if (!S->opts->budget_ns)
+        return false;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > S->deadline.tv_sec || (now.tv_sec == S->deadline.tv_sec && now.tv_nsec >= S->deadline.tv_nsec);
+}
+
+// put `shape` at its spawn, for the plies that guess the piece
+static void set_piece(engine_t *E, const shapes_t shape)
+{
+    E->tetromino.shape = shape;
+    E->tetromino.x = TETROMINO_SPAWN_X;
+    E->tetromino.y = TETROMINO_SPAWN_Y;
+    E->tetromino.rotation = 0;
+    E->tetromino.bitmap = PIECE(shape, 0)->bitmap;
+}
+
+// lock `shape` at `P` on a copy of `parent`
+static void place(engine_t *child, const engine_t *parent, const shapes_t shape, const placement_t *P)
+{
+    *child = *parent;
+    child->tetromino.shape = shape;
+    child->tetromino.x = P->x;
+    child->tetromino.y = P->y;
+    child->tetromino.rotation = P->rotation;
+    child->tetromino.bitmap = PIECE(shape, P->rotation)->bitmap;
+    engine_step(child, IN_HARD_DROP);
+}
+
+// score the boards waiting in the batch
+static void flush(search_t *S, worker_t *W, cand_t *cands)
+{
+    int32_t out[EVAL_LANES];
+
+    if (!W->batch.count)
+        return;
+    eval_score(&W->batch, &S->opts->weights, out, EVAL_AUTO);
+    for (int i = 0; i < W->batch.count; i++) {
+        cands[W->lanes[i].cand].score = out[i] + W->lanes[i].lines;
+        if (S->opts->tt)
+            tt_store(S->opts->tt, W->lanes[i].key, out[i], 0);
+    }
+    eval_reset(&W->batch);
+}
+
+// place `shape` everywhere it can go on `parent` and score every result into `cands`, returns how many there were
+static int expand(search_t *S, worker_t *W, const node_t *parent, const int index, const shapes_t shape,
+                  const int ply, cand_t *cands)
+{
+    const eval_weights_t *w = &S->opts->weights;
+    const movegen_t *gen = &W->gen;
+    engine_t tmp, child;
+    int n = 0;
+
+    // checked before every movegen() and after every batch, so no ply runs far past the deadline, the first included
+    if ((W->timed_out = W->timed_out || expired(S)))
+        return 0;
+    if (ply == 0) {
+        gen = S->roots;
+    } else {
+        tmp = parent->state;
+        if (ply >= 2)
+            set_piece(&tmp, shape);
+        movegen(&W->gen, &tmp, false);
+    }
+
+    for (int i = 0; i < gen->count && !W->timed_out; i++) {
+        // the root placements are dealt out to the threads in turn
+        if (ply == 0 && (i % S->threads != (int)(W - S->workers) || !S->usable[i]))
+            continue;
+
+        cand_t *c = &cands[n++];
+        c->parent = ply == 0 ? i : index;       // the first ply records the root placement instead
+        c->piece = shape;
+        c->placement = gen->placements[i];
+        place(&child, &parent->state, shape, &c->placement);
+        W->boards++;
+        if (!child.running) {
+            c->score = SEARCH_LOSS;
+            continue;
+        }
+
+        // the cached score is the static eval of the board alone: it does not depend on the pieces or the ply, so
+        // the board hash is the whole key and the depth is always 0. The lines depend on the path and are added here
+        const int32_t lines = w->lines * (child.lines - S->root->lines);
+        const uint64_t key = child.hash;
+        int32_t score;
+        int depth;
+        if (S->opts->tt && tt_probe(S->opts->tt, key, &score, &depth)) {
+            c->score = score + lines;
+            W->tt_hits++;
+            continue;
+        }
+        W->lanes[W->batch.count].cand = n - 1;
+        W->lanes[W->batch.count].lines = lines;
+        W->lanes[W->batch.count].key = key;
+        eval_add(&W->batch, &child, 0);
+        if (W->batch.count == EVAL_LANES) {
+            flush(S, W, cands);
+            W->timed_out = expired(S);
+        }
+    }
+    flush(S, W, cands);
+    return n;
+}
+
+static int by_score(const void *a, const void *b)
+{
+    const cand_t *x = a, *y = b;
+
+    if (x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    if (x->parent != y->parent)
+        return x->parent < y->parent ? -1 : 1;
+    return (int)x->placement.state - (int)y->placement.state;
+}
+
+// turn the best `n` candidates into the next beam, skipping boards the beam already has
+static void select_beam(search_t *S, worker_t *W, const node_t *root, const int n, const int ply)
+{
+    int size = 0;
+
+    qsort(W->cands, (size_t)n, sizeof(cand_t), by_score);
+    for (int i = 0; i < n && size < S->opts->width; i++) {
+        const cand_t *c = &W->cands[i];
+        const node_t *parent = ply == 0 ? root : &W->beam[c->parent];
+        node_t *child = &W->next[size];
+
+        if (c->score == SEARCH_LOSS)
+            break;
+        place(&child->state, &parent->state, c->piece, &c->placement);
+        child->root = ply == 0 ? c->parent : parent->root;
+        child->bag = parent->bag;
+        if (ply >= 2 && !(child->bag &= (uint8_t)~SHAPE_BIT(c->piece)))
+            child->bag = ALL_SHAPES;
+
+        int dup = 0;
+        for (int j = 0; j < size && !dup; j++)
+            dup = W->next[j].state.hash == child->state.hash && W->next[j].bag == child->bag;
+        size += !dup;
+    }
+
+    node_t *tmp = W->beam;
+    W->beam = W->next;
+    W->next = tmp;
+    W->size = size;
+}
+
+// shapes the bag still holds after the preview, a fresh bag when the preview was its last one
+static uint8_t bag_after_preview(const engine_t *E)
+{
+    uint8_t bag = 0;
+
+    for (int i = E->bag.idx + 1; i < BAG_SIZE; i++)
+        bag |= (uint8_t)SHAPE_BIT(E->bag.tetrominos[i]);
+    return bag ? bag : ALL_SHAPES;
+}
+
+// run the whole beam search over this thread's share of the root placements
+static void work(void *ctx, const int idx, const int thread)
+{
+    search_t *S = ctx;
+    worker_t *W = &S->workers[idx];
+    node_t root = {.state = *S->root, .bag = bag_after_preview(S->root)};
+
+    (void)thread;
+    eval_reset(&W->batch);
+    for (int ply = 0; ply < S->opts->depth; ply++) {
+        int n = 0;
+
+        if (ply == 0) {
+            n = expand(S, W, &root, 0, S->root->tetromino.shape, 0, W->cands);
+        } else {
+            for (int b = 0; b < W->size && !W->timed_out; b++) {
+                const node_t *parent = &W->beam[b];
+                if (ply == 1) {
+                    n += expand(S, W, parent, b, parent->state.tetromino.shape, ply, &W->cands[n]);
+                    W->timed_out |= expired(S);
+                    continue;
+                }
+
+                // an unknown piece, keep the best child for each shape and rank them all by the average
+                int64_t sum = 0;
+                int shapes = 0, first = n;
+                for (shapes_t s = I_tet; s <= L_tet; s++) {
+                    if (!(parent->bag & SHAPE_BIT(s)))
+                        continue;
+                    int m = expand(S, W, parent, b, s, ply, &W->cands[n]), best = n;
+                    for (int i = n + 1; i < n + m; i++)
+                        if (W->cands[i].score > W->cands[best].score)
+                            best = i;
+                    sum += m ? W->cands[best].score : SEARCH_LOSS;
+                    shapes++;
+                    if (m)
+                        W->cands[n++] = W->cands[best];
+                }
+                for (int i = first; i < n; i++)
+                    W->cands[i].score = (int32_t)(sum / shapes);
+                W->timed_out |= expired(S);
+            }
+        }
+
+        // a ply cut short by the budget is thrown away, unless it is the first and there is nothing else
+        if (W->timed_out && ply > 0)
+            break;
+        if (!n)
+            break;
+        select_beam(S, W, &root, n, ply);
+        if (!W->size)
+            break;
+        W->best[ply].score = W->cands[0].score;
+        W->best[ply].root = W->beam[0].root;
+        W->depth = ply + 1;
+        if (W->timed_out || (W->timed_out = expired(S)))
+            break;
+    }
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+void search_defaults(search_opts_t *O)
+{
+    O->depth = 3;
+    O->width = 16;
+    O->threads = 1;
+    O->budget_ns = 1000000;
+    O->weights = (eval_weights_t){.height = -510, .holes = -356, .bumpiness = -184, .wells = -40, .lines = 760};
+    O->tt = NULL;
+    O->pool = NULL;
+}
+
+// search from the current state of `E`, returns 0 on success, -1 if memory ran out
+int search_beam(const engine_t *E, const search_opts_t *O, search_result_t *R)
+{
+    search_t S = {.root = E, .opts = O};
+    const int width = O->width > 0 ? O->width : 1;
+    const int depth = O->depth < SEARCH_MAX_DEPTH ? O->depth : SEARCH_MAX_DEPTH;
+    search_opts_t opts = *O;
+    int status = -1, done = SEARCH_MAX_DEPTH + 1;
+
+    // the budget covers the whole call, generating the root placements and their paths included
+    clock_gettime(CLOCK_MONOTONIC, &S.deadline);
+    S.deadline.tv_sec += (time_t)(O->budget_ns / 1000000000);
+    S.deadline.tv_nsec += (long)(O->budget_ns % 1000000000);
+    if (S.deadline.tv_nsec >= 1000000000) {
+        S.deadline.tv_sec++;
+        S.deadline.tv_nsec -= 1000000000;
+    }
+    opts.width = width;
+    opts.depth = depth > 0 ? depth : 1;
+    S.opts = &opts;
+
+    memset(R, 0, sizeof(*R));
+    S.roots = malloc(sizeof(movegen_t));
+    if (!S.roots)
+        return -1;
+    if (!movegen(S.roots, E, true)) {
+        free(S.roots);
+        return 0;
+    }
+    S.threads = O->threads > 0 ? O->threads : 1;
+    if (S.threads > S.roots->count)
+        S.threads = S.roots->count;
+
+    // candidates: every placement of each board in the beam, or one per shape plus the shape being tried
+    S.usable = calloc((size_t)S.roots->count, sizeof(bool));
+    S.workers = aligned_alloc(64, sizeof(worker_t) * (size_t)S.threads);
+    if (!S.usable || !S.workers)
+        goto out;
+    memset(S.workers, 0, sizeof(worker_t) * (size_t)S.threads);
+    for (int i = 0; i < S.threads; i++) {
+        worker_t *W = &S.workers[i];
+        W->beam = malloc(sizeof(node_t) * (size_t)width);
+        W->next = malloc(sizeof(node_t) * (size_t)width);
+        W->cands = malloc(sizeof(cand_t) * (size_t)(width + 1) * MOVEGEN_MAX);
+        if (!W->beam || !W->next || !W->cands)
+            goto out;
+    }
+    for (int i = 0; i < S.roots->count; i++) {
+        input_t path[MOVEGEN_PATH_MAX];
+        S.usable[i] = movegen_path(S.roots, i, path, SEARCH_MAX_INPUTS) > 0;
+    }
+
+    if (O->pool ? pool_exec(O->pool, S.threads, work, &S) : pool_run(S.threads, S.threads, work, &S))
+        goto out;
+
+    // compare the threads at the deepest ply all of them finished
+    for (int i = 0; i < S.threads; i++) {
+        R->boards += S.workers[i].boards;
+        R->tt_hits += S.workers[i].tt_hits;
+        R->timed_out |= S.workers[i].timed_out;
+        if (S.workers[i].depth && S.workers[i].depth < done)
+            done = S.workers[i].depth;
+    }
+    status = 0;
+    if (done > SEARCH_MAX_DEPTH) {
+        // no thread finished a ply: every root placement ends the game or the budget ran out before any was scored,
+        // so play the first one that can be reached
+        R->score = SEARCH_LOSS;
+        for (int i = 0; i < S.roots->count && !R->count; i++) {
+            if (S.usable[i]) {
+                R->placement = S.roots->placements[i];
+                R->count = movegen_path(S.roots, i, R->inputs, SEARCH_MAX_INPUTS);
+            }
+        }
+        goto out;
+    }
+    R->depth = done;
+    R->score = SEARCH_LOSS;
+    for (int i = 0, first = 1; i < S.threads; i++) {
+        const worker_t *W = &S.workers[i];
+        if (W->depth && (first || W->best[done-1].score > R->score)) {
+            R->score = W->best[done-1].score;
+            R->placement = S.roots->placements[W->best[done-1].root];
+            R->count = movegen_path(S.roots, W->best[done-1].root, R->inputs, SEARCH_MAX_INPUTS);
+            first = 0;
+        }
+    }
+
+out:
+    for (int i = 0; S.workers && i < S.threads; i++) {
+        free(S.workers[i].beam);
+        free(S.workers[i].next);
+        free(S.workers[i].cands);
+    }
+    free(S.workers);
+    free(S.usable);
+    free(S.roots);
+    return status;
+}
+
+// search and play the chosen placement, returns the events of its last step. When the search fails or finds nowhere
+// to go the tetromino is hard dropped, so every call locks a piece and a game always comes to an end. `R` may be NULL,
+// otherwise it gets the search's result
+unsigned search_play(engine_t *E, const search_opts_t *O, search_result_t *R)
+{
+    search_result_t local;
+    unsigned ev = EV_NONE;
+
+    if (!R)
+        R = &local;
+    if (search_beam(E, O, R) || !R->count)
+        return engine_step(E, IN_HARD_DROP);
+    for (int i = 0; i < R->count; i++)
+        ev = engine_step(E, R->inputs[i]);
+    return ev;
+}
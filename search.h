@@ -0,0 +1,56 @@
+//======================================================================================================================
+// File Name    : search.h
+// Description  : Lookahead beam search: places the current piece, the preview and then whatever the 7-bag can still
+//                deal, keeps the best boards after every ply and returns the placement leading to the best one
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_SEARCH_H
+#define TETRIS_SEARCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "engine.h"
+#include "eval.h"
+#include "movegen.h"
+#include "pool.h"
+#include "tt.h"
+
+// MACROS //
+#define SEARCH_MAX_DEPTH    8
+#define SEARCH_MAX_INPUTS   64
+
+
+// TYPEDEFS //
+typedef struct {
+    int depth;                          // plies, the current piece is the first and the preview the second
+    int width;                          // boards kept after each ply
+    int threads;                        // the root placements are split over this many threads
+    pool_t *pool;                       // optional threads kept between searches, otherwise each search starts its own
+    int64_t budget_ns;                  // wall time allowed for one search, 0 for no limit
+    eval_weights_t weights;
+    tt_t *tt;                           // optional cache of static board scores keyed by the board hash alone,
+                                        // may be shared by several searches and games
+} search_opts_t;
+
+typedef struct {
+    placement_t placement;
+    input_t inputs[SEARCH_MAX_INPUTS];  // from the spawn to the lock, see `movegen_path()`
+    int count;                          // 0 when the current piece has nowhere to go
+    int32_t score;
+    int depth;                          // plies completed inside the budget
+    long boards;                        // boards generated and scored
+    long tt_hits;                       // of those, boards whose score came from `tt` instead of the evaluator
+    bool timed_out;
+} search_result_t;
+
+
+// PROTOTYPES //
+void search_defaults(search_opts_t *O);
+int search_beam(const engine_t *E, const search_opts_t *O, search_result_t *R);
+unsigned search_play(engine_t *E, const search_opts_t *O, search_result_t *R);
+
+#endif //TETRIS_SEARCH_H
@@ -0,0 +1,542 @@
+//======================================================================================================================
+// File Name    : server.c
+// Description  : Game server. Sessions are woken by their socket or by a hashed timer wheel with one slot per tick,
+//                set to the next tick at which gravity or the lock delay can change the game, so an idle session
+//                costs nothing between its deadlines. Ticks are run lazily up to the current server tick
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#define _GNU_SOURCE                     // accept4()
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "pool.h"
+#include "server.h"
+
+// MACROS //
+#define NS_PER_SEC          1000000000LL
+#define TICK_NS             ((int64_t)TICK_US * 1000)
+#define WHEEL_SLOTS         256         // ticks the wheel spans, a later deadline goes round it more than once
+#define MAX_EVENTS          256
+#define MAX_LATE            8           // ticks a session catches up at once, as in sched.c the rest are dropped
+#define KEYS_PER_READ       64
+#define ACCEPT_BATCH        4           // connections taken per wakeup, the rest wake another worker
+#define CLOSE_TICKS         (5 * NS_PER_SEC / TICK_NS)  // a finished game's last state waits this long for the client
+
+_Static_assert(MSG_HELLO_SIZE + MSG_STATE_SIZE <= UINT8_MAX, "a session's messages must fit the uint8_t out_len");
+
+
+// TYPEDEFS //
+// one game, all of it in one allocation
+typedef struct session_s {
+    engine_t game;
+    struct session_s *prev;             // timer wheel slot
+    struct session_s *next;
+    uint64_t start;                     // server tick on which the game's tick 0 fell
+    uint64_t deadline;                  // server tick of the next wakeup
+    int fd;
+    bool dirty;                         // a state is owed to the client, it was not reading
+    bool polling_out;                   // waiting for EPOLLOUT to send the rest of `out`
+    bool closing;                       // the game is over, the session closes once its last state is out
+    uint8_t out_pos;
+    uint8_t out_len;
+    uint8_t out[MSG_HELLO_SIZE + MSG_STATE_SIZE];
+} session_t;
+
+typedef struct {
+    int ep;
+    int timer;
+    uint64_t tick;                      // server tick the wheel has run up to
+    uint64_t armed;                     // server tick `timer` is set for, 0 when disarmed
+    session_t *slots[WHEEL_SLOTS];
+    server_stats_t stats;
+} worker_t;
+
+
+// DATA //
+static struct {
+    int listen_fd;
+    int stop_fd;
+    int64_t origin;                     // CLOCK_MONOTONIC ns of server tick 0
+    _Atomic uint64_t seed;              // seed of the next game
+    _Atomic uint64_t live;
+    _Atomic uint64_t peak;
+    worker_t *workers;
+} srv = {.listen_fd = -1, .stop_fd = -1};
+
+
+// HELPER FUNCTIONS //
+static uint64_t now_tick(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)(((int64_t)t.tv_sec * NS_PER_SEC + t.tv_nsec - srv.origin) / TICK_NS);
+}
+
+static void put32(uint8_t *p, const uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static int pack_hello(uint8_t *p, const uint64_t seed)
+{
+    p[0] = MSG_HELLO;
+    p[1] = RULESET_VERSION;
+    p[2] = PF_W;
+    p[3] = BOARD_H;
+    put32(p + 4, (uint32_t)seed);
+    put32(p + 8, (uint32_t)(seed >> 32));
+    return MSG_HELLO_SIZE;
+}
+
+static int pack_state(uint8_t *p, const engine_t *E)
+{
+    uint32_t row;
+
+    p[0] = MSG_STATE;
+    p[1] = E->running ? MSG_STATE_RUNNING : 0;
+    p[2] = (uint8_t)E->tetromino.shape;
+    p[3] = (uint8_t)E->tetromino.rotation;
+    p[4] = (uint8_t)(int8_t)E->tetromino.x;
+    p[5] = (uint8_t)(int8_t)E->tetromino.y;
+    p[6] = (uint8_t)E->next_shape;
+    p[7] = (uint8_t)E->level;
+    put32(p + 8, (uint32_t)E->tick);
+    put32(p + 12, (uint32_t)E->score);
+    put32(p + 16, (uint32_t)E->lines);
+    for (int i = 0; i < PLAYFIELD_HEIGHT; i++) {
+        row = (E->rows[PF_BUFF_SIZE + i] >> ROW_PAD) & ((1u << PF_W) - 1);
+        for (int b = 0; b < MSG_ROW_SIZE; b++)
+            p[20 + MSG_ROW_SIZE*i + b] = (uint8_t)(row >> (8 * b));
+    }
+    return MSG_STATE_SIZE;
+}
+
+// same keys as the terminal game
+static input_t key_input(const uint8_t ch)
+{
+    switch (ch) {
+        case 'a':   return IN_LEFT;
+        case 'd':   return IN_RIGHT;
+        case 's':   return IN_SOFT_DROP;
+        case 'e':   return IN_CW;
+        case 'q':   return IN_CCW;
+        case 'z':   return IN_HARD_DROP;
+        case 'x':   return IN_QUIT;
+        case 'o':   return IN_LEVEL_DOWN;
+        case 'p':   return IN_LEVEL_UP;
+        default:    return IN_NONE;
+    }
+}
+
+
+// TIMER WHEEL //-------------------------------------------------------------------------------------------------------
+static void wheel_add(worker_t *W, session_t *S, const uint64_t tick)
+{
+    session_t **slot = &W->slots[tick % WHEEL_SLOTS];
+
+    S->deadline = tick;
+    S->prev = NULL;
+    S->next = *slot;
+    if (*slot)
+        (*slot)->prev = S;
+    *slot = S;
+}
+
+static void wheel_del(worker_t *W, session_t *S)
+{
+    if (S->prev)
+        S->prev->next = S->next;
+    else if (W->slots[S->deadline % WHEEL_SLOTS] == S)
+        W->slots[S->deadline % WHEEL_SLOTS] = S->next;
+    if (S->next)
+        S->next->prev = S->prev;
+    S->prev = S->next = NULL;
+}
+
+// set the timerfd for the first occupied slot, its sessions may only be due on a later lap
+static void wheel_arm(worker_t *W)
+{
+    struct itimerspec t = {.it_interval = {0, 0}};
+    uint64_t tick = 0;
+    int64_t at;
+
+    for (uint64_t i = W->tick + 1; i <= W->tick + WHEEL_SLOTS; i++)
+        if (W->slots[i % WHEEL_SLOTS]) {
+            tick = i;
+            break;
+        }
+    if (tick == W->armed)
+        return;
+    if (tick) {
+        at = srv.origin + (int64_t)tick * TICK_NS;
+        t.it_value = (struct timespec){.tv_sec = at / NS_PER_SEC, .tv_nsec = at % NS_PER_SEC};
+    }
+    timerfd_settime(W->timer, TFD_TIMER_ABSTIME, &t, NULL);
+    W->armed = tick;
+}
+
+
+// SESSIONS //----------------------------------------------------------------------------------------------------------
+static void session_close(worker_t *W, session_t *S)
+{
+    wheel_del(W, S);
+    close(S->fd);
+    free(S);
+    atomic_fetch_sub(&srv.live, 1);
+}
+
+// send what is left of `out`, false once the client is gone
+static bool session_flush(worker_t *W, session_t *S)
+{
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = S};
+    ssize_t n;
+
+    while (S->out_pos < S->out_len) {
+        n = send(S->fd, S->out + S->out_pos, (size_t)(S->out_len - S->out_pos), MSG_NOSIGNAL);
+        if (n > 0) {
+            S->out_pos += (uint8_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!S->polling_out) {
+                ev.events |= EPOLLOUT;
+                epoll_ctl(W->ep, EPOLL_CTL_MOD, S->fd, &ev);
+                S->polling_out = true;
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+    if (S->polling_out) {
+        epoll_ctl(W->ep, EPOLL_CTL_MOD, S->fd, &ev);
+        S->polling_out = false;
+    }
+    return true;
+}
+
+// send the current state, or owe it until the last message is out. A newer state replaces one that is owed
+static bool session_send(worker_t *W, session_t *S)
+{
+    if (S->out_pos < S->out_len) {
+        W->stats.dropped += S->dirty;
+        S->dirty = true;
+        return true;
+    }
+    S->out_len = (uint8_t)pack_state(S->out, &S->game);
+    S->out_pos = 0;
+    S->dirty = false;
+    W->stats.messages++;
+    return session_flush(W, S);
+}
+
+// run the game's ticks up to server tick `now`, a wakeup more than MAX_LATE ticks past its deadline drops the surplus
+static unsigned session_catch_up(session_t *S, const uint64_t now)
+{
+    unsigned ev = EV_NONE;
+
+    if (now > S->deadline + MAX_LATE)
+        S->start += now - S->deadline - MAX_LATE;
+    while (S->game.running && S->game.tick < now - S->start)
+        ev |= engine_step(&S->game, IN_TICK);
+    return ev;
+}
+
+// tell the client what changed, then wake the session at its next deadline. Once the game is over the session closes
+// as soon as the final state is out, or leaves it to the EPOLLOUT path, which gets CLOSE_TICKS to send it
+static void session_update(worker_t *W, session_t *S, const bool changed, const uint64_t now)
+{
+    if (changed && !session_send(W, S)) {
+        session_close(W, S);
+        return;
+    }
+    if (!S->game.running) {
+        if (S->out_pos == S->out_len && !S->dirty) {
+            session_close(W, S);
+        } else if (!S->closing) {
+            S->closing = true;
+            wheel_del(W, S);
+            wheel_add(W, S, now + CLOSE_TICKS);
+        }
+        return;
+    }
+    wheel_del(W, S);
+    wheel_add(W, S, now + (uint64_t)engine_idle_ticks(&S->game));
+}
+
+static void session_accept(worker_t *W, const int fd, const uint64_t now)
+{
+    struct epoll_event ev = {.events = EPOLLIN};
+    session_t *S = calloc(1, sizeof(session_t));
+    uint64_t live, peak, seed = atomic_fetch_add(&srv.seed, 1);
+    const int one = 1;
+
+    if (!S) {
+        close(fd);
+        return;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on a Unix socket
+    S->fd = fd;
+    S->start = now;
+    engine_init(&S->game, seed);
+    ev.data.ptr = S;
+    if (epoll_ctl(W->ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        free(S);
+        return;
+    }
+
+    W->stats.sessions++;
+    live = atomic_fetch_add(&srv.live, 1) + 1;
+    peak = atomic_load(&srv.peak);
+    while (live > peak && !atomic_compare_exchange_weak(&srv.peak, &peak, live))
+        ;
+
+    S->out_len = (uint8_t)pack_hello(S->out, seed);
+    S->out_len += (uint8_t)pack_state(S->out + S->out_len, &S->game);
+    W->stats.messages++;
+    wheel_add(W, S, now + (uint64_t)engine_idle_ticks(&S->game));
+    if (!session_flush(W, S))
+        session_close(W, S);
+}
+
+// ticks that came due, then every key the client sent, on the current tick
+static void session_read(worker_t *W, session_t *S, const uint64_t now)
+{
+    uint8_t keys[KEYS_PER_READ];
+    unsigned ev = session_catch_up(S, now);
+    bool changed = ev != EV_NONE;
+    ssize_t n;
+    input_t in;
+
+    for (;;) {
+        n = read(S->fd, keys, sizeof(keys));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0) {
+            session_close(W, S);
+            return;
+        }
+        for (ssize_t i = 0; i < n && S->game.running; i++) {
+            if ((in = key_input(keys[i])) == IN_NONE)
+                continue;
+            changed |= engine_step(&S->game, in) != EV_NONE || in == IN_LEVEL_DOWN || in == IN_LEVEL_UP;
+        }
+    }
+    session_update(W, S, changed, now);
+}
+
+// run every session whose deadline passed, each slot up to `now` is visited once
+static void wheel_run(worker_t *W, const uint64_t now)
+{
+    session_t *S, *next;
+
+    if (now - W->tick > WHEEL_SLOTS)
+        W->tick = now - WHEEL_SLOTS;
+    while (W->tick < now) {
+        session_t **slot = &W->slots[++W->tick % WHEEL_SLOTS];
+
+        S = *slot;
+        *slot = NULL;
+        for (; S; S = next) {
+            next = S->next;
+            if (S->deadline > now) {
+                wheel_add(W, S, S->deadline);
+                continue;
+            }
+            S->prev = S->next = NULL;
+            if (S->closing)
+                session_close(W, S);    // the client never read the final state
+            else
+                session_update(W, S, session_catch_up(S, now) != EV_NONE, now);
+        }
+    }
+}
+
+
+// WORKERS //-----------------------------------------------------------------------------------------------------------
+static void worker_close(worker_t *W)
+{
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+        while (W->slots[i])
+            session_close(W, W->slots[i]);
+    if (W->timer >= 0)
+        close(W->timer);
+    if (W->ep >= 0)
+        close(W->ep);
+}
+
+// accept new sessions, serve them and their timers until `server_stop()`
+static void worker_run(void *ctx, const int idx, const int worker)
+{
+    worker_t *W = &srv.workers[idx];
+    struct epoll_event evs[MAX_EVENTS];
+    uint64_t now, expirations;
+    int n, fd;
+
+    (void)ctx;
+    (void)worker;
+    for (;;) {
+        n = epoll_wait(W->ep, evs, MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR)
+            break;
+        now = now_tick();
+        for (int i = 0; i < n; i++) {
+            void *ptr = evs[i].data.ptr;
+
+            if (ptr == &srv.stop_fd) {
+                worker_close(W);
+                return;
+            } else if (ptr == &srv.listen_fd) {
+                for (int j = 0; j < ACCEPT_BATCH; j++) {
+                    if ((fd = accept4(srv.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0)
+                        break;
+                    session_accept(W, fd, now);
+                }
+            } else if (ptr == &W->timer) {
+                (void) !read(W->timer, &expirations, sizeof(expirations));
+                W->armed = 0;
+            } else if (evs[i].events & (EPOLLERR | EPOLLHUP) && !(evs[i].events & EPOLLIN)) {
+                session_close(W, ptr);
+            } else if (evs[i].events & EPOLLIN) {
+                session_read(W, ptr, now);
+            } else if (evs[i].events & EPOLLOUT) {
+                session_t *S = ptr;
+                if (!session_flush(W, S) || (S->dirty && S->out_pos == S->out_len && !session_send(W, S)) ||
+                    (S->closing && S->out_pos == S->out_len && !S->dirty))
+                    session_close(W, S);
+            }
+        }
+        wheel_run(W, now);
+        wheel_arm(W);
+    }
+    worker_close(W);
+}
+
+static int worker_init(worker_t *W)
+{
+    struct epoll_event ev;
+
+    memset(W, 0, sizeof(*W));
+    W->tick = now_tick();
+    W->ep = epoll_create1(EPOLL_CLOEXEC);
+    W->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (W->ep < 0 || W->timer < 0)
+        return -1;
+
+    // the listening socket wakes one worker per connection, not all of them
+    ev = (struct epoll_event){.events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = &srv.listen_fd};
+    if (epoll_ctl(W->ep, EPOLL_CTL_ADD, srv.listen_fd, &ev) < 0)
+        return -1;
+    ev = (struct epoll_event){.events = EPOLLIN, .data.ptr = &srv.stop_fd};
+    if (epoll_ctl(W->ep, EPOLL_CTL_ADD, srv.stop_fd, &ev) < 0)
+        return -1;
+    ev = (struct epoll_event){.events = EPOLLIN, .data.ptr = &W->timer};
+    return epoll_ctl(W->ep, EPOLL_CTL_ADD, W->timer, &ev);
+}
+
+static int listen_on(const server_opts_t *O)
+{
+    struct sockaddr_un un = {.sun_family = AF_UNIX};
+    struct sockaddr_in in = {.sin_family = AF_INET, .sin_port = htons((uint16_t)O->port),
+                             .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    const int one = 1;
+    int fd;
+
+    if (O->unix_path) {
+        if (strlen(O->unix_path) >= sizeof(un.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(un.sun_path, O->unix_path);
+        unlink(O->unix_path);
+    }
+    fd = socket(O->unix_path ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if ((O->unix_path ? bind(fd, (struct sockaddr *)&un, sizeof(un)) : bind(fd, (struct sockaddr *)&in, sizeof(in)))
+        || listen(fd, SOMAXCONN)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// API //---------------------------------------------------------------------------------------------------------------
+// serve games until `server_stop()`, returns 0, or -1 with errno set when the server could not start
+int server_run(const server_opts_t *O, server_stats_t *stats)
+{
+    struct timespec t;
+    int err = 0, threads = O->threads > 0 ? O->threads : 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    srv.origin = (int64_t)t.tv_sec * NS_PER_SEC + t.tv_nsec;
+    atomic_store(&srv.seed, O->seed);
+    atomic_store(&srv.live, 0);
+    atomic_store(&srv.peak, 0);
+    memset(stats, 0, sizeof(*stats));
+
+    srv.listen_fd = listen_on(O);
+    srv.stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    srv.workers = calloc((size_t)threads, sizeof(worker_t));
+    for (int i = 0; srv.workers && i < threads; i++)
+        srv.workers[i].ep = srv.workers[i].timer = -1;
+    if (srv.listen_fd < 0 || srv.stop_fd < 0 || !srv.workers)
+        err = -1;
+    for (int i = 0; !err && i < threads; i++)
+        err = worker_init(&srv.workers[i]);
+
+    if (!err && pool_run(threads, threads, worker_run, NULL))
+        err = -1;
+
+    for (int i = 0; srv.workers && i < threads; i++) {
+        stats->sessions += srv.workers[i].stats.sessions;
+        stats->messages += srv.workers[i].stats.messages;
+        stats->dropped += srv.workers[i].stats.dropped;
+        if (err)
+            worker_close(&srv.workers[i]);
+    }
+    stats->peak = atomic_load(&srv.peak);
+
+    free(srv.workers);
+    srv.workers = NULL;
+    if (srv.listen_fd >= 0)
+        close(srv.listen_fd);
+    if (srv.stop_fd >= 0)
+        close(srv.stop_fd);
+    if (O->unix_path)
+        unlink(O->unix_path);
+    srv.listen_fd = srv.stop_fd = -1;
+    return err ? -1 : 0;
+}
+
+// make every worker close its sessions and return, safe to call from a signal handler
+void server_stop(void)
+{
+    const uint64_t one = 1;
+
+    if (srv.stop_fd >= 0)
+        (void) !write(srv.stop_fd, &one, sizeof(one));
+}
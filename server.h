@@ -0,0 +1,55 @@
+//======================================================================================================================
+// File Name    : server.h
+// Description  : Many headless games in one process, played over Unix or localhost TCP sockets. Each worker thread
+//                owns an epoll set and a timer wheel, and every session it accepts stays on it
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_SERVER_H
+#define TETRIS_SERVER_H
+
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+// Protocol. The client sends the game's keys as single bytes: a d s e q z to play, o p for the level, x to quit.
+// The server sends messages that start with their type, every integer is little-endian
+//   MSG_HELLO   type ruleset:1 width:1 height:1 seed:8, once, first. The board is width columns by height rows
+//   MSG_STATE   type flags:1 shape:1 rotation:1 x:1 y:1 next:1 level:1 tick:4 score:4 lines:4 rows
+//               whenever ticks or a batch of keys changed the game. y is signed, rows are the PLAYFIELD_HEIGHT
+//               visible rows from the buffer strip down, MSG_ROW_SIZE bytes each with column 0 in bit PF_W-1.
+//               A client too slow to read skips states
+// The server closes the connection once the game is over, after its last MSG_STATE
+#define MSG_HELLO           1
+#define MSG_HELLO_SIZE      12
+#define MSG_STATE           2
+#define MSG_ROW_SIZE        ((PF_W + 7) / 8)
+#define MSG_STATE_SIZE      (20 + MSG_ROW_SIZE*PLAYFIELD_HEIGHT)
+#define MSG_STATE_RUNNING   0x01        // flags: the game goes on
+#define SERVER_PORT         7777
+
+
+// TYPEDEFS //
+typedef struct {
+    const char *unix_path;              // Unix socket to listen on, NULL to listen on localhost TCP
+    int port;                           // TCP port
+    int threads;
+    uint64_t seed;                      // seed of the first game, each new one gets the next
+} server_opts_t;
+
+typedef struct {
+    uint64_t sessions;                  // games played
+    uint64_t peak;                      // most games running at once
+    uint64_t messages;                  // MSG_STATE sent
+    uint64_t dropped;                   // states not sent because the client was not reading, a later one replaced them
+} server_stats_t;
+
+
+// PROTOTYPES //
+int server_run(const server_opts_t *O, server_stats_t *stats);
+void server_stop(void);
+
+#endif //TETRIS_SERVER_H
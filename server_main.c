@@ -0,0 +1,66 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "pool.h"
+#include "server.h"
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    server_stop();
+}
+
+// serve games over a socket until SIGINT or SIGTERM, then report what was served
+int main(int argc, char *argv[])
+{
+    server_opts_t O = {.unix_path = NULL, .port = SERVER_PORT, .threads = pool_cpus(), .seed = 1};
+    server_stats_t stats;
+    struct sigaction sa = {.sa_handler = on_signal};
+    struct rlimit lim;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "u:p:j:s:")) != -1) {
+        switch (opt) {
+            case 'u':
+                O.unix_path = optarg;
+                break;
+            case 'p':
+                O.port = atoi(optarg);
+                break;
+            case 'j':
+                O.threads = atoi(optarg);
+                break;
+            case 's':
+                O.seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-u unix-socket | -p localhost-port] [-j threads] [-s first-seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    // every session is a socket, allow as many as the hard limit does
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (O.unix_path)
+        fprintf(stderr, "serving on %s with %d threads\n", O.unix_path, O.threads);
+    else
+        fprintf(stderr, "serving on 127.0.0.1:%d with %d threads\n", O.port, O.threads);
+    if (server_run(&O, &stats)) {
+        perror(argv[0]);
+        return 1;
+    }
+    printf("%llu sessions, %llu at most at once, %llu states sent, %llu skipped for slow clients\n",
+           (unsigned long long)stats.sessions, (unsigned long long)stats.peak, (unsigned long long)stats.messages,
+           (unsigned long long)stats.dropped);
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "policy.h"
+#include "pool.h"
+#include "replay.h"
+#include "search.h"
+
+typedef struct {
+    uint64_t seed;
+    int score;
+    int lines;
+    int level;
+    long pieces;
+    long boards;                        // boards the beam search scored, and how many of those the table answered
+    long tt_hits;
+    int status;                         // replay status, always REPLAY_OK for policy games
+} sim_game_t;
+
+typedef struct {
+    sim_game_t *games;
+    char **replays;                     // NULL to play seeded games with the built-in policy
+    uint64_t seed;
+    long max_pieces;
+    bool beam;                          // play with `search_play()` instead of the greedy policy
+    search_opts_t search;
+    tt_t tt;                            // shared by every game when -T is given
+} sim_t;
+
+// play game `idx` to the end, or until it has placed `max_pieces`
+static void run_game(void *ctx, const int idx, const int worker)
+{
+    sim_t *S = ctx;
+    sim_game_t *G = &S->games[idx];
+    replay_result_t R;
+    search_opts_t opts = S->search;
+    search_result_t found;
+    engine_t E;
+
+    (void)worker;
+    if (S->replays) {
+        G->status = replay_play(S->replays[idx], &R);
+        G->seed = R.seed;
+        G->score = R.actual.score;
+        G->lines = R.actual.lines;
+        G->level = R.level;
+        G->pieces = (long)R.pieces;
+        return;
+    }
+
+    // a search split over threads reuses the same ones for every piece of the game, or starts its own without them
+    if (S->beam && opts.threads > 1)
+        opts.pool = pool_create(opts.threads);
+    G->seed = S->seed + (uint64_t)idx;
+    engine_init(&E, G->seed);
+    while (E.running && G->pieces < S->max_pieces) {
+        if (!S->beam) {
+            G->pieces += (policy_play(&E) & EV_LOCKED) != 0;
+            continue;
+        }
+        G->pieces += (search_play(&E, &opts, &found) & EV_LOCKED) != 0;
+        G->boards += found.boards;
+        G->tt_hits += found.tt_hits;
+    }
+    pool_destroy(opts.pool);
+    G->score = E.score;
+    G->lines = E.lines;
+    G->level = E.level;
+}
+
+// run many games across every core and report how fast they went
+int main(int argc, char *argv[])
+{
+    static const char *status_str[] = {"ok", "MISMATCH", "cannot open", "bad format"};
+    sim_t S = {.seed = 1, .max_pieces = 10000};
+    int opt, count = 1000, threads = pool_cpus(), verbose = 0, failed = 0, w, h;
+    long long pieces = 0, lines = 0, score = 0, level = 0, boards = 0, tt_hits = 0;
+    long tt_mb = 0;
+    struct timespec s, e;
+    double secs;
+
+    search_defaults(&S.search);
+    while ((opt = getopt(argc, argv, "n:j:s:p:vbd:w:t:T:J:B:")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 's':
+                S.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'p':
+                S.max_pieces = atol(optarg);
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'b':
+                S.beam = true;
+                break;
+            case 'd':
+                S.search.depth = atoi(optarg);
+                break;
+            case 'w':
+                S.search.width = atoi(optarg);
+                break;
+            case 't':
+                S.search.budget_ns = atol(optarg) * 1000;
+                break;
+            case 'T':
+                tt_mb = atol(optarg);
+                break;
+            case 'J':
+                S.search.threads = atoi(optarg);
+                break;
+            case 'B':
+                if (sscanf(optarg, "%dx%d", &w, &h) != 2) {
+                    fprintf(stderr, "%s: -B takes a board size like 10x20\n", argv[0]);
+                    return 2;
+                }
+                if (w != PF_W || h != BOARD_H) {
+                    engine_exec_board("tetris-sim", w, h, argv);
+                    fprintf(stderr, "%s: no build for the %dx%d board\n", argv[0], w, h);
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-B WxH] [-n games] [-j threads] [-s first-seed] [-p max-pieces] [-v]\n"
+                                "       [-b [-d depth] [-w width] [-t budget-us] [-T table-MB] [-J threads-per-search]]\n"
+                                "       [replay-file...]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind < argc) {
+        S.replays = &argv[optind];
+        count = argc - optind;
+    }
+    if (count <= 0 || !(S.games = calloc((size_t)count, sizeof(sim_game_t)))) {
+        fprintf(stderr, "%s: nothing to run\n", argv[0]);
+        return 2;
+    }
+    if (tt_mb > 0) {
+        if (tt_init(&S.tt, (size_t)tt_mb << 20)) {
+            fprintf(stderr, "%s: cannot allocate a %ld MB transposition table\n", argv[0], tt_mb);
+            return 1;
+        }
+        S.search.tt = &S.tt;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &s);
+    if (pool_run(threads, count, run_game, &S)) {
+        fprintf(stderr, "%s: cannot start the thread pool\n", argv[0]);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    secs = (double)(e.tv_sec - s.tv_sec) + (double)(e.tv_nsec - s.tv_nsec) / 1e9;
+
+    if (verbose)
+        printf("game,seed,status,score,lines,pieces,level\n");
+    for (int i = 0; i < count; i++) {
+        sim_game_t *G = &S.games[i];
+        if (verbose)
+            printf("%d,%llu,%s,%d,%d,%ld,%d\n", i, (unsigned long long)G->seed, status_str[G->status], G->score,
+                   G->lines, G->pieces, G->level);
+        if (G->status != REPLAY_OK) {
+            failed++;
+            continue;
+        }
+        pieces += G->pieces;
+        lines += G->lines;
+        score += G->score;
+        level += G->level;
+        boards += G->boards;
+        tt_hits += G->tt_hits;
+    }
+
+    printf("%d games on the %dx%d board on %d threads in %.3f s, %d failed\n", count, PF_W, BOARD_H,
+           threads < count ? threads : count, secs, failed);
+    if (count > failed)
+        printf("mean score %.1f, lines %.1f, pieces %.1f, level %.2f\n", (double)score / (count - failed),
+               (double)lines / (count - failed), (double)pieces / (count - failed), (double)level / (count - failed));
+    printf("%lld pieces, %.0f pieces/s\n", pieces, secs > 0 ? (double)pieces / secs : 0);
+    if (S.beam)
+        printf("%lld boards searched, %.1f%% scored from the transposition table\n", boards,
+               boards ? 100.0 * (double)tt_hits / (double)boards : 0);
+
+    if (S.search.tt)
+        tt_free(&S.tt);
+    free(S.games);
+    return failed != 0;
+}
@@ -0,0 +1,215 @@
+//======================================================================================================================
+// File Name    : snapshot.c
+// Description  : Packing a game into a snapshot and back, and checkpoint files of snapshots
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pieces.h"
+#include "snapshot.h"
+
+// MACROS //
+#define FNV_OFFSET          1469598103934665603ULL
+#define FNV_PRIME           1099511628211ULL
+#define SNAPSHOT_END        (offsetof(snapshot_t, y) + sizeof(int8_t))     // the tail padding is never written
+
+_Static_assert(offsetof(snapshot_t, rows) == 48, "snapshot fields must not be padded");
+_Static_assert(L_tet < 16, "every shape must fit in a nibble");
+
+
+// HELPER FUNCTIONS //
+// FNV-1a a word at a time, folded to 32 bits
+static uint32_t checksum(const snapshot_t *S)
+{
+    const uint8_t *p = (const uint8_t *)S + sizeof(S->check), *end = (const uint8_t *)S + SNAPSHOT_END;
+    uint64_t h = FNV_OFFSET, w;
+
+    for (; p + sizeof(w) <= end; p += sizeof(w)) {
+        memcpy(&w, p, sizeof(w));
+        h = (h ^ w) * FNV_PRIME;
+        h ^= h >> 32;
+    }
+    for (; p < end; p++)
+        h = (h ^ *p) * FNV_PRIME;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static bool valid_shape(const int shape)
+{
+    return shape >= I_tet && shape <= L_tet;
+}
+
+// slot of the latest save in `C`, the intact snapshot with the highest tick. -1 when every slot is empty or torn
+static int newest_slot(const checkpoint_t *C)
+{
+    int newest = -1;
+
+    for (uint32_t i = 0; i < C->slots; i++)
+        if (C->slot[i].check == checksum(&C->slot[i]) && (newest < 0 || C->slot[i].tick > C->slot[newest].tick))
+            newest = (int)i;
+    return newest;
+}
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// pack `E` into `S`, which may be a slot of a mapped checkpoint
+void snapshot_save(snapshot_t *S, const engine_t *E)
+{
+    S->flags = E->running ? SNAPSHOT_RUNNING : 0;
+    S->tick = E->tick;
+    S->rng_state = E->rng.state;
+    S->rng_inc = E->rng.inc;
+    S->score = E->score;
+    S->lines = E->lines;
+    S->gravity_acc = E->gravity_acc;
+    S->slide_ticks = E->slide_ticks;
+    memcpy(S->rows, E->rows, sizeof(S->rows));
+    memset(S->colors, 0, sizeof(S->colors));
+    for (int y = PF_H - 1; y >= 0 && E->rows[y] != ROW_EMPTY; y--)   // the stack is contiguous from the floor
+        for (int x = 0; x < PF_W; x += 2)
+            S->colors[y][x/2] = (uint8_t)(E->colors[y][x] | (x + 1 < PF_W ? E->colors[y][x+1] << 4 : 0));
+    for (int i = 0; i < BAG_SIZE; i++)
+        S->bag[i] = (uint8_t)E->bag.tetrominos[i];
+    S->bag_idx = (uint8_t)E->bag.idx;
+    S->next_shape = (uint8_t)E->next_shape;
+    S->level = (uint8_t)E->level;
+    S->shape = (uint8_t)E->tetromino.shape;
+    S->rotation = (uint8_t)E->tetromino.rotation;
+    S->x = (int8_t)E->tetromino.x;
+    S->y = (int8_t)E->tetromino.y;
+    S->check = checksum(S);
+}
+
+// Unpack a running game from `S` into `E`. Returns 0, or -1 and leaves `E` alone when the slot is empty, was torn
+// by a crash in the middle of a save, or does not hold a game this engine could have played
+int snapshot_load(engine_t *E, const snapshot_t *S)
+{
+    engine_t G;
+    tetromino_t *tet = &G.tetromino;
+    bool ok;
+
+    if (S->check != checksum(S) || !(S->flags & SNAPSHOT_RUNNING))
+        return -1;
+    ok = valid_shape(S->shape) && valid_shape(S->next_shape) && S->rotation < 4 && S->level >= 1
+         && S->level <= GRAV_LEVELS && S->bag_idx < BAG_SIZE && S->x >= TET_X_MIN && S->x <= TET_X_MAX
+         && S->y >= 0 && S->y <= PF_H;
+    for (int i = 0; i < BAG_SIZE; i++)
+        ok &= valid_shape(S->bag[i]);
+    if (!ok)
+        return -1;
+
+    memset(&G, 0, sizeof(G));
+    for (int y = PF_H; y < PF_H + PF_FLOOR; y++)
+        G.rows[y] = ROW_FULL;
+    G.running = true;
+    G.tick = S->tick;
+    G.rng.state = S->rng_state;
+    G.rng.inc = S->rng_inc;
+    G.score = S->score;
+    G.lines = S->lines;
+    G.gravity_acc = S->gravity_acc;
+    G.slide_ticks = S->slide_ticks;
+    memcpy(G.rows, S->rows, sizeof(S->rows));
+    for (int y = PF_H - 1; y >= 0 && S->rows[y] != ROW_EMPTY; y--)
+        for (int x = 0; x < PF_W; x++)
+            G.colors[y][x] = (S->colors[y][x/2] >> (4 * (x & 1))) & 0xF;
+    for (int i = 0; i < BAG_SIZE; i++)
+        G.bag.tetrominos[i] = (shapes_t)S->bag[i];
+    G.bag.idx = S->bag_idx;
+    G.next_shape = (shapes_t)S->next_shape;
+    G.level = S->level;
+    tet->shape = (shapes_t)S->shape;
+    tet->rotation = S->rotation;
+    tet->x = S->x;
+    tet->y = S->y;
+    tet->bitmap = PIECE(tet->shape, tet->rotation)->bitmap;
+    tet->falling = true;
+    engine_rebuild(&G);
+    if (!piece_fits(G.rows, PIECE(tet->shape, tet->rotation), tet->x, tet->y))
+        return -1;
+
+    *E = G;
+    return 0;
+}
+
+// Map the checkpoint file at `path`, creating it with `slots` empty slots if it does not exist. Returns NULL with
+// errno set on failure, EINVAL when the file is not a checkpoint of this build with that many slots
+checkpoint_t *checkpoint_map(const char *path, const uint32_t slots)
+{
+    const size_t size = sizeof(checkpoint_t) + slots * sizeof(snapshot_t);
+    checkpoint_t *C = MAP_FAILED;
+    struct stat st;
+    int fd, err;
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+        return NULL;
+    if (fstat(fd, &st) == 0 && (st.st_size == (off_t)size || (st.st_size == 0 && ftruncate(fd, (off_t)size) == 0)))
+        C = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    else if (st.st_size != 0)
+        errno = EINVAL;
+    err = errno;
+    close(fd);
+    if (C == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    // a new file reads as zeros, which is empty slots under no header
+    if (!C->magic[0] && !C->slots) {
+        memcpy(C->magic, CHECKPOINT_MAGIC, 4);
+        C->format = CHECKPOINT_FORMAT;
+        C->ruleset = RULESET_VERSION;
+        C->snapshot_size = sizeof(snapshot_t);
+        C->slots = slots;
+        C->width = PF_W;
+        C->height = BOARD_H;
+    }
+    if (memcmp(C->magic, CHECKPOINT_MAGIC, 4) != 0 || C->format != CHECKPOINT_FORMAT || C->ruleset != RULESET_VERSION
+        || C->snapshot_size != sizeof(snapshot_t) || C->slots != slots || C->width != PF_W || C->height != BOARD_H) {
+        munmap(C, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    return C;
+}
+
+// Resume the game of the latest save in `C` into `E`. Returns 0, or -1 when that save holds no running game, in which
+// case every slot is emptied so the saves of a new game are not mistaken for older than the last one of the old game
+int checkpoint_resume(checkpoint_t *C, engine_t *E)
+{
+    const int newest = newest_slot(C);
+
+    if (newest >= 0 && !snapshot_load(E, &C->slot[newest]))
+        return 0;
+    memset(C->slot, 0, C->slots * sizeof(snapshot_t));
+    return -1;
+}
+
+// Save `E` over the slot after the latest save, so a crash in the middle of it leaves the latest one whole. A save at
+// the same tick replaces the latest one instead, the ticks of the slots then never tie
+void checkpoint_save(checkpoint_t *C, const engine_t *E)
+{
+    const int newest = newest_slot(C);
+
+    if (newest < 0)
+        snapshot_save(&C->slot[0], E);
+    else if (C->slot[newest].tick == E->tick)
+        snapshot_save(&C->slot[newest], E);
+    else
+        snapshot_save(&C->slot[((uint32_t)newest + 1) % C->slots], E);
+}
+
+void checkpoint_unmap(checkpoint_t *C)
+{
+    if (C)
+        munmap(C, sizeof(checkpoint_t) + C->slots * sizeof(snapshot_t));
+}
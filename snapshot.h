@@ -0,0 +1,73 @@
+//======================================================================================================================
+// File Name    : snapshot.h
+// Description  : Packed, fixed-size snapshots of a game. A snapshot holds no pointers, so one memcpy forks it and a
+//                checkpoint file is just an array of them, mapped into memory and written in place
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_SNAPSHOT_H
+#define TETRIS_SNAPSHOT_H
+
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+#define SNAPSHOT_RUNNING    0x1         // flags: a game that goes on, a slot without it is empty
+#define CHECKPOINT_MAGIC    "TTCK"
+#define CHECKPOINT_FORMAT   2
+#define CHECKPOINT_SLOTS    2           // a game saves over its older slot, a torn save leaves the newer one
+
+
+// TYPEDEFS //
+// Everything `engine_step()` reads or writes, except what `engine_rebuild()` recomputes from the rows (metrics, hash)
+// and the last line clear. Fields are ordered widest first so there is no padding between them, `check` covers the
+// ones after it
+typedef struct {
+    uint32_t check;                     // checksum of the snapshot after this field, a torn write fails it
+    uint32_t flags;
+    uint64_t tick;
+    uint64_t rng_state;
+    uint64_t rng_inc;
+    int32_t score;
+    int32_t lines;
+    int32_t gravity_acc;
+    int32_t slide_ticks;
+    row_t rows[PF_H];                   // occupancy with the wall bits, see BITBOARD
+    uint8_t colors[PF_H][(PF_W+1)/2];   // shapes, two cells a byte, the even column in the low nibble
+    uint8_t bag[BAG_SIZE];
+    uint8_t bag_idx;
+    uint8_t next_shape;
+    uint8_t level;
+    uint8_t shape;
+    uint8_t rotation;
+    int8_t x;
+    int8_t y;
+} snapshot_t;
+
+// Checkpoint file layout: this header then `slots` snapshots. The layout is the host's, so a checkpoint is read back
+// by a build with the same ruleset, board and snapshot size
+typedef struct {
+    char magic[4];
+    uint8_t format;
+    uint8_t ruleset;
+    uint16_t snapshot_size;
+    uint32_t slots;
+    uint8_t width;                      // board the games are played on, PF_W by BOARD_H
+    uint8_t height;
+    uint16_t reserved;
+    snapshot_t slot[];
+} checkpoint_t;
+
+
+// PROTOTYPES //
+void snapshot_save(snapshot_t *S, const engine_t *E);
+int snapshot_load(engine_t *E, const snapshot_t *S);
+checkpoint_t *checkpoint_map(const char *path, uint32_t slots);
+int checkpoint_resume(checkpoint_t *C, engine_t *E);
+void checkpoint_save(checkpoint_t *C, const engine_t *E);
+void checkpoint_unmap(checkpoint_t *C);
+
+#endif //TETRIS_SNAPSHOT_H
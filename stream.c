@@ -0,0 +1,544 @@
+//======================================================================================================================
+// File Name    : stream.c
+// Description  : Spectator stream writer, ring buffer readers and the decoder that rebuilds the game from the records
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pieces.h"
+#include "stream.h"
+
+// MACROS //
+#define CELL_BITS           3
+#define XR(x, rot)          ((uint8_t)(((x) - TET_X_MIN) | (rot) << 5))
+
+_Static_assert(L_tet < (1 << CELL_BITS), "every shape must fit in a cell");
+_Static_assert(TET_X_COUNT <= 32, "x must fit in the low 5 bits of xr");
+_Static_assert(16 + 4*10 + 7 + 16 + 2 + (PF_H*PF_W*CELL_BITS + 7) / 8 <= STREAM_MAX_RECORD, "a keyframe must fit");
+
+
+// TYPEDEFS //
+// reads one record, `cut` is set when it runs past the end of the bytes and `bad` when they make no sense
+typedef struct {
+    const uint8_t *p;
+    size_t n;
+    size_t i;
+    bool cut;
+    bool bad;
+} cursor_t;
+
+
+// HELPER FUNCTIONS //
+static void put_byte(stream_writer_t *W, const uint8_t v)
+{
+    W->out[W->len++] = v;
+}
+
+static void put_varint(stream_writer_t *W, uint64_t v)
+{
+    while (v >= 0x80) {
+        put_byte(W, (uint8_t)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    put_byte(W, (uint8_t)v);
+}
+
+static void put_head(stream_writer_t *W, const int kind, const uint64_t tick)
+{
+    uint64_t gap = tick - W->last_tick;
+
+    put_byte(W, (uint8_t)(kind << 4 | (gap < STREAM_GAP_VARINT ? gap : STREAM_GAP_VARINT)));
+    if (gap >= STREAM_GAP_VARINT)
+        put_varint(W, gap);
+    W->last_tick = tick;
+}
+
+// bring readers' tetromino to `tet`, nothing when they already have it
+static void put_piece(stream_writer_t *W, const tetromino_t *tet, const uint64_t tick)
+{
+    tetromino_t *S = &W->sent;
+
+    if (tet->x == S->x && tet->rotation == S->rotation && tet->y == S->y + 1) {
+        put_head(W, REC_FALL, tick);
+    } else if (tet->x != S->x || tet->y != S->y || tet->rotation != S->rotation) {
+        put_head(W, REC_MOVE, tick);
+        put_byte(W, XR(tet->x, tet->rotation));
+        put_varint(W, (uint64_t)tet->y);
+    }
+    *S = *tet;
+}
+
+static void put_key(stream_writer_t *W, const engine_t *E)
+{
+    const tetromino_t *tet = &E->tetromino;
+    const int height = E->metrics.max_height;
+    uint32_t bag = (uint32_t)E->bag.idx << (BAG_SIZE * CELL_BITS), bits = 0;
+    int nbits = 0;
+
+    W->key_at = W->len;
+    put_head(W, REC_KEY, W->last_tick);
+    put_varint(W, E->tick);
+    put_varint(W, (uint64_t)E->score);
+    put_varint(W, (uint64_t)E->lines);
+    put_varint(W, (uint64_t)E->level);
+    put_byte(W, (uint8_t)tet->shape);
+    put_byte(W, XR(tet->x, tet->rotation));
+    put_varint(W, (uint64_t)tet->y);
+    put_byte(W, (uint8_t)E->next_shape);
+    for (int i = 0; i < BAG_SIZE; i++)
+        bag |= (uint32_t)E->bag.tetrominos[i] << (i * CELL_BITS);
+    for (int i = 0; i < 3; i++)
+        put_byte(W, (uint8_t)(bag >> (8*i)));
+    for (int i = 0; i < 8; i++)
+        put_byte(W, (uint8_t)(E->rng.state >> (8*i)));
+    for (int i = 0; i < 8; i++)
+        put_byte(W, (uint8_t)(E->rng.inc >> (8*i)));
+
+    // the stack is contiguous from the floor, nothing above its highest row is occupied
+    put_varint(W, (uint64_t)height);
+    for (int y = PF_H - height; y < PF_H; y++) {
+        for (int x = 0; x < PF_W; x++) {
+            bits |= (uint32_t)E->colors[y][x] << nbits;
+            if ((nbits += CELL_BITS) >= 8) {
+                put_byte(W, (uint8_t)bits);
+                bits >>= 8;
+                nbits -= 8;
+            }
+        }
+    }
+    if (nbits)
+        put_byte(W, (uint8_t)bits);
+
+    W->last_tick = E->tick;
+    W->key_tick = E->tick;
+    W->sent = *tet;
+}
+
+// copy `out` into the ring, then move `head` past it
+static void publish(stream_writer_t *W)
+{
+    stream_ring_t *ring = W->ring;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t at = (size_t)(head % ring->size), first = ring->size - at;
+
+    if (first > (size_t)W->len)
+        first = (size_t)W->len;
+    memcpy(ring->data + at, W->out, first);
+    memcpy(ring->data, W->out + first, (size_t)W->len - first);
+    atomic_store_explicit(&ring->head, head + (uint64_t)W->len, memory_order_release);
+    if (W->key_at >= 0)
+        atomic_store_explicit(&ring->key, head + (uint64_t)W->key_at, memory_order_release);
+    W->len = 0;
+    W->key_at = -1;
+}
+
+static uint8_t get_byte(cursor_t *C)
+{
+    if (C->i >= C->n) {
+        C->cut = true;
+        return 0;
+    }
+    return C->p[C->i++];
+}
+
+static uint64_t get_varint(cursor_t *C)
+{
+    uint64_t v = 0;
+    uint8_t b;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        b = get_byte(C);
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    C->bad = true;
+    return 0;
+}
+
+// read an xr byte and a y, false when that position is off the playfield
+static bool get_position(cursor_t *C, tetromino_t *tet)
+{
+    uint8_t xr = get_byte(C);
+    uint64_t y = get_varint(C);
+
+    tet->x = (xr & 0x1F) + TET_X_MIN;
+    tet->rotation = xr >> 5;
+    tet->y = (int)(y <= PF_H ? y : PF_H + 1);
+    return tet->x <= TET_X_MAX && tet->rotation < 4 && tet->y <= PF_H;
+}
+
+static bool valid_shape(const uint64_t shape)
+{
+    return shape >= I_tet && shape <= L_tet;
+}
+
+// a tetromino only ever rests where it fits, anything else would make the engine read off the playfield
+static bool piece_ok(const engine_t *E, const tetromino_t *tet)
+{
+    return piece_fits(E->rows, PIECE(tet->shape, tet->rotation), tet->x, tet->y);
+}
+
+// read a keyframe into `G`, the cursor is past the record's first byte
+static void get_key(cursor_t *C, engine_t *G)
+{
+    tetromino_t *tet = &G->tetromino;
+    uint64_t score, lines, level, shape, next, height;
+    uint32_t bag = 0, bits = 0;
+    int nbits = 0;
+
+    engine_init(G, 0);
+    G->tick = get_varint(C);
+    score = get_varint(C);
+    lines = get_varint(C);
+    level = get_varint(C);
+    shape = get_byte(C);
+    if (!get_position(C, tet))
+        C->bad = true;
+    next = get_byte(C);
+    for (int i = 0; i < 3; i++)
+        bag |= (uint32_t)get_byte(C) << (8*i);
+    G->rng.state = G->rng.inc = 0;
+    for (int i = 0; i < 8; i++)
+        G->rng.state |= (uint64_t)get_byte(C) << (8*i);
+    for (int i = 0; i < 8; i++)
+        G->rng.inc |= (uint64_t)get_byte(C) << (8*i);
+    height = get_varint(C);
+    if (C->cut || C->bad || score > INT32_MAX || lines > INT32_MAX || level < 1 || level > GRAV_LEVELS
+        || !valid_shape(shape) || !valid_shape(next) || height > PF_H) {
+        C->bad = true;
+        return;
+    }
+
+    G->score = (int)score;
+    G->lines = (int)lines;
+    G->level = (int)level;
+    tet->shape = (shapes_t)shape;
+    tet->bitmap = PIECE(tet->shape, tet->rotation)->bitmap;
+    G->next_shape = (shapes_t)next;
+    for (int i = 0; i < BAG_SIZE; i++) {
+        G->bag.tetrominos[i] = (shapes_t)((bag >> (i * CELL_BITS)) & 7);
+        if (!valid_shape(G->bag.tetrominos[i]))
+            C->bad = true;
+    }
+    G->bag.idx = (int)(bag >> (BAG_SIZE * CELL_BITS));
+    if (G->bag.idx >= BAG_SIZE)
+        C->bad = true;
+
+    for (int y = PF_H - (int)height; y < PF_H && !C->cut; y++) {
+        for (int x = 0; x < PF_W; x++) {
+            if (nbits < CELL_BITS) {
+                bits |= (uint32_t)get_byte(C) << nbits;
+                nbits += 8;
+            }
+            G->colors[y][x] = bits & 7;
+            bits >>= CELL_BITS;
+            nbits -= CELL_BITS;
+            if (G->colors[y][x] > L_tet)
+                C->bad = true;
+            else if (G->colors[y][x])
+                G->rows[y] |= (row_t)ROW_BIT(x);
+        }
+    }
+    engine_rebuild(G);
+    if (!C->cut && !piece_ok(G, tet))
+        C->bad = true;
+}
+
+// Apply the record at the start of `p`. Returns its length, 0 when it is cut off by the end of the bytes, -1 when
+// it is not a record
+static int decode_record(stream_decoder_t *D, const uint8_t *p, const size_t n)
+{
+    engine_t key;                       // decoded into before it replaces the game
+    cursor_t C = {.p = p, .n = n};
+    engine_t *G = &D->game;
+    tetromino_t tet;
+    uint8_t head = get_byte(&C);
+    uint64_t gap = head & 0xF, level = 0;
+    int kind = head >> 4;
+
+    if (gap == STREAM_GAP_VARINT)
+        gap = get_varint(&C);
+    switch (kind) {
+        case REC_KEY:
+            get_key(&C, &key);
+            break;
+        case REC_MOVE:
+            C.bad |= !get_position(&C, &tet);
+            break;
+        case REC_LEVEL:
+            level = get_varint(&C);
+            C.bad |= level < 1 || level > GRAV_LEVELS;
+            break;
+        case REC_FALL:
+        case REC_LOCK:
+        case REC_END:
+            break;
+        default:
+            C.bad = true;
+    }
+    if (C.cut)
+        return 0;
+    if (C.bad)
+        return -1;
+
+    D->records++;
+    if (kind == REC_KEY) {
+        *G = key;
+        D->synced = true;
+        D->ended = false;
+        D->keyframes++;
+        return (int)C.i;
+    }
+    if (!D->synced)
+        return (int)C.i;
+
+    G->tick += gap;
+    switch (kind) {
+        case REC_MOVE:
+            tet.shape = G->tetromino.shape;
+            if (!piece_ok(G, &tet))
+                return -1;
+            G->tetromino.x = tet.x;
+            G->tetromino.y = tet.y;
+            G->tetromino.rotation = tet.rotation;
+            G->tetromino.bitmap = PIECE(tet.shape, tet.rotation)->bitmap;
+            break;
+        case REC_FALL:
+            G->tetromino.y++;
+            if (!piece_ok(G, &G->tetromino))
+                return -1;
+            break;
+        case REC_LOCK:
+            engine_step(G, IN_HARD_DROP);
+            break;
+        case REC_LEVEL:
+            G->level = (int)level;
+            break;
+        case REC_END:
+            G->running = false;
+            D->ended = true;
+            break;
+    }
+    return (int)C.i;
+}
+
+
+// WRITER //------------------------------------------------------------------------------------------------------------
+// create the ring file at `path` and start it with a keyframe of `E`, returns 0 on success, -1 with errno set
+int stream_open(stream_writer_t *W, const char *path, const engine_t *E)
+{
+    const size_t size = sizeof(stream_ring_t) + STREAM_RING_SIZE;
+    int fd, err;
+
+    memset(W, 0, sizeof(*W));
+    W->key_at = -1;
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+        return -1;
+    if (ftruncate(fd, (off_t)size) == 0)
+        W->ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (!W->ring || W->ring == MAP_FAILED) {
+        W->ring = NULL;
+        unlink(path);
+        errno = err;
+        return -1;
+    }
+
+    memcpy(W->ring->magic, STREAM_MAGIC, 4);
+    W->ring->format = STREAM_FORMAT;
+    W->ring->ruleset = RULESET_VERSION;
+    W->ring->width = PF_W;
+    W->ring->height = BOARD_H;
+    W->ring->size = STREAM_RING_SIZE;
+    W->path = path;
+    put_key(W, E);
+    publish(W);
+    return 0;
+}
+
+// Advance the game by a single input like `engine_step()`, and record what readers cannot work out for themselves:
+// where a tetromino locked from, level changes, the end of the game and a keyframe every STREAM_KEY_TICKS. Other
+// moves wait for `stream_flush()`
+unsigned stream_step(stream_writer_t *W, engine_t *E, const input_t in)
+{
+    const tetromino_t before = E->tetromino;
+    const int level = E->level;
+    const bool running = E->running;
+    unsigned ev = engine_step(E, in);
+
+    if (!W->ring || !running)
+        return ev;
+
+    // the engine only locks a tetromino after dropping it straight down, readers drop it from where it was
+    if (ev & EV_LOCKED) {
+        put_piece(W, &before, E->tick);
+        put_head(W, REC_LOCK, E->tick);
+        W->sent = E->tetromino;
+    } else if (E->level != level) {
+        put_head(W, REC_LEVEL, E->tick);
+        put_varint(W, (uint64_t)E->level);
+    }
+    if (!E->running) {
+        put_piece(W, &E->tetromino, E->tick);
+        put_head(W, REC_END, E->tick);
+    } else if (in == IN_TICK && E->tick - W->key_tick >= STREAM_KEY_TICKS) {
+        put_key(W, E);
+    }
+    if (W->len)
+        publish(W);
+    return ev;
+}
+
+// record where the tetromino is now, once per wakeup of the game loop, so every move it made since is one record
+void stream_flush(stream_writer_t *W, const engine_t *E)
+{
+    if (!W->ring || !E->running)
+        return;
+    put_piece(W, &E->tetromino, E->tick);
+    if (W->len)
+        publish(W);
+}
+
+// unmap the ring and remove its file, readers that have it mapped keep it until they detach
+void stream_close(stream_writer_t *W)
+{
+    if (!W->ring)
+        return;
+    munmap(W->ring, sizeof(stream_ring_t) + W->ring->size);
+    unlink(W->path);
+    W->ring = NULL;
+}
+
+
+// READERS //-----------------------------------------------------------------------------------------------------------
+// map the ring file at `path` and start reading at its latest keyframe, returns 0 on success, -1 with errno set
+int stream_attach(stream_reader_t *R, const char *path)
+{
+    struct stat st;
+    stream_ring_t *ring = MAP_FAILED;
+    int fd;
+
+    memset(R, 0, sizeof(*R));
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)(sizeof(stream_ring_t) + STREAM_RING_SIZE))
+        ring = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    else
+        errno = EINVAL;
+    close(fd);
+    if (ring == MAP_FAILED)
+        return -1;
+    if (memcmp(ring->magic, STREAM_MAGIC, 4) != 0 || ring->format != STREAM_FORMAT
+        || ring->ruleset != RULESET_VERSION || ring->width != PF_W || ring->height != BOARD_H
+        || ring->size != STREAM_RING_SIZE) {
+        munmap(ring, (size_t)st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    R->ring = ring;
+    R->pos = atomic_load_explicit(&ring->key, memory_order_acquire);
+    return 0;
+}
+
+// Copy up to `max` bytes written since the last read into `buf`, returns how many. With `max` at STREAM_RING_SIZE
+// every read ends on a record. A reader a whole ring behind the writer starts again from the latest keyframe
+size_t stream_read(stream_reader_t *R, uint8_t *buf, const size_t max)
+{
+    const stream_ring_t *ring = R->ring;
+    uint64_t key = atomic_load_explicit(&ring->key, memory_order_acquire);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t n, at, first;
+
+    // the writer may be filling up to STREAM_MAX_BATCH bytes past the head it published
+    if (head + STREAM_MAX_BATCH - R->pos > ring->size) {
+        R->pos = key;
+        R->resyncs++;
+    }
+    n = head - R->pos < max ? (size_t)(head - R->pos) : max;
+    at = (size_t)(R->pos % ring->size);
+    first = ring->size - at < n ? ring->size - at : n;
+    memcpy(buf, ring->data + at, first);
+    memcpy(buf + first, ring->data, n - first);
+
+    // the copy is only good if none of it was overwritten while it was being made
+    atomic_thread_fence(memory_order_acquire);
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head + STREAM_MAX_BATCH - R->pos > ring->size) {
+        R->pos = atomic_load_explicit(&ring->key, memory_order_acquire);
+        R->resyncs++;
+        return 0;
+    }
+    R->pos += n;
+    return n;
+}
+
+void stream_detach(stream_reader_t *R)
+{
+    if (R->ring)
+        munmap((void *)R->ring, sizeof(stream_ring_t) + R->ring->size);
+    R->ring = NULL;
+}
+
+
+// DECODER //-----------------------------------------------------------------------------------------------------------
+// write what a piped stream starts with, returns its length STREAM_PREAMBLE
+int stream_preamble(uint8_t *buf)
+{
+    memcpy(buf, STREAM_MAGIC, 4);
+    buf[4] = STREAM_FORMAT;
+    buf[5] = RULESET_VERSION;
+    buf[6] = PF_W;
+    buf[7] = BOARD_H;
+    return STREAM_PREAMBLE;
+}
+
+// Apply the `n` bytes at `p` to `D->game`, a record may be cut anywhere between two calls. Returns the number of
+// records applied, -1 when the bytes are not a stream
+int stream_decode(stream_decoder_t *D, const uint8_t *p, const size_t n)
+{
+    size_t i = 0, take;
+    int used, count = 0;
+
+    while (i < n) {
+        if (!D->len) {
+            if ((used = decode_record(D, p + i, n - i)) < 0)
+                return -1;
+            if (!used) {
+                memcpy(D->buf, p + i, n - i);   // shorter than a record
+                D->len = (int)(n - i);
+                break;
+            }
+            i += (size_t)used;
+            count++;
+            continue;
+        }
+
+        // finish the record that was cut off, it takes part of the new bytes
+        take = sizeof(D->buf) - (size_t)D->len < n - i ? sizeof(D->buf) - (size_t)D->len : n - i;
+        memcpy(D->buf + D->len, p + i, take);
+        if ((used = decode_record(D, D->buf, (size_t)D->len + take)) < 0)
+            return -1;
+        if (!used) {
+            if ((size_t)D->len + take == sizeof(D->buf))
+                return -1;              // longer than any record
+            D->len += (int)take;
+            i += take;
+            continue;
+        }
+        i += (size_t)used - (size_t)D->len;
+        D->len = 0;
+        count++;
+    }
+    return count;
+}
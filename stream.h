@@ -0,0 +1,111 @@
+//======================================================================================================================
+// File Name    : stream.h
+// Description  : Spectator stream of a game: a keyframe of the whole state every few seconds and, between them, small
+//                records of what the tetromino did on each tick. The game writes it to a ring buffer in a shared
+//                file and never waits for its readers, any number of which follow it from the latest keyframe
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_STREAM_H
+#define TETRIS_STREAM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+// MACROS //
+// Records start with a byte (kind << 4) | gap, gap being the ticks since the previous record or STREAM_GAP_VARINT
+// when a varint with the gap follows. Integers are unsigned LEB128 varints unless noted
+//   REC_KEY     tick score lines level shape xr y next bag:3 rng:16 height cells
+//               the gap is always 0. xr is (x - TET_X_MIN) | rotation << 5, bag is its seven shapes and its index
+//               3 bits each from bit 0, rng is its state then its increment, 8 bytes little-endian each. cells are
+//               the shapes of the `height` rows of the stack from the top down, 3 bits each from bit 0 of the first
+//               byte, padded to a whole byte
+//   REC_MOVE    xr y        where the tetromino is now, the moves since the last record are merged into one
+//   REC_FALL                the tetromino fell a row and nothing else changed, the usual move under gravity
+//   REC_LOCK                the tetromino dropped straight down and locked. Readers lock it with their own engine,
+//                           which clears the lines, scores and spawns the next tetromino from the keyframe's bag
+//   REC_LEVEL   level       the player changed the level
+//   REC_END                 the game is over
+// A stream piped out of the ring (see tetris-watch) starts with STREAM_MAGIC, STREAM_FORMAT, RULESET_VERSION and the
+// board width and height as single bytes, then the records from a keyframe on
+#define STREAM_MAGIC        "TTST"
+#define STREAM_FORMAT       2
+#define STREAM_PREAMBLE     8
+#define STREAM_GAP_VARINT   15
+#define STREAM_MAX_RECORD   (128 + PF_H*PF_W*3/8)  // longer than any keyframe, its cells take 3 bits each
+#define STREAM_MAX_BATCH    (2*STREAM_MAX_RECORD)   // bytes the writer publishes at once at most
+#define STREAM_RING_SIZE    (64*1024)   // holds many keyframe intervals, a power of two
+#define STREAM_KEY_TICKS    600         // ticks between keyframes (10s), a late reader waits at most this long
+
+enum stream_records_e {
+    REC_KEY = 1,
+    REC_MOVE,
+    REC_FALL,
+    REC_LOCK,
+    REC_LEVEL,
+    REC_END,
+};
+
+
+// TYPEDEFS //
+// Shared file layout. The writer fills bytes ahead of `head` and then publishes them, a reader copies what is behind
+// `head` and checks it was not overwritten meanwhile, like a seqlock
+typedef struct {
+    char magic[4];
+    uint8_t format;
+    uint8_t ruleset;
+    uint8_t width;                      // board the game is played on, PF_W by BOARD_H
+    uint8_t height;
+    uint32_t size;                      // bytes of `data`, STREAM_RING_SIZE
+    _Atomic uint64_t head;              // bytes written since the stream began, byte i is at data[i % size]
+    _Atomic uint64_t key;               // stream offset of the latest keyframe
+    uint8_t data[];
+} stream_ring_t;
+
+typedef struct {
+    stream_ring_t *ring;                // NULL when not streaming, `stream_step()` then only steps the game
+    const char *path;
+    tetromino_t sent;                   // the tetromino as readers have it
+    uint64_t last_tick;                 // tick of the previous record, gaps are delta encoded against it
+    uint64_t key_tick;                  // tick of the latest keyframe
+    int len;                            // bytes of `out` not yet published
+    int key_at;                         // offset in `out` of a keyframe in it, -1 if there is none
+    uint8_t out[STREAM_MAX_BATCH];
+} stream_writer_t;
+
+typedef struct {
+    const stream_ring_t *ring;
+    uint64_t pos;                       // stream offset of the next byte to read
+    uint64_t resyncs;                   // times the reader fell a whole ring behind and went back to a keyframe
+} stream_reader_t;
+
+// rebuilds the game from the records
+typedef struct {
+    engine_t game;                      // valid once `synced`, the tetromino and the stack as the writer has them
+    bool synced;                        // a keyframe was read, records before it are skipped
+    bool ended;
+    uint64_t records;
+    uint64_t keyframes;
+    int len;                            // bytes of a record cut off by the end of the last chunk
+    uint8_t buf[STREAM_MAX_RECORD];
+} stream_decoder_t;
+
+
+// PROTOTYPES //
+int stream_open(stream_writer_t *W, const char *path, const engine_t *E);
+unsigned stream_step(stream_writer_t *W, engine_t *E, input_t in);
+void stream_flush(stream_writer_t *W, const engine_t *E);
+void stream_close(stream_writer_t *W);
+int stream_attach(stream_reader_t *R, const char *path);
+size_t stream_read(stream_reader_t *R, uint8_t *buf, size_t max);
+void stream_detach(stream_reader_t *R);
+int stream_preamble(uint8_t *buf);
+int stream_decode(stream_decoder_t *D, const uint8_t *p, size_t n);
+
+#endif //TETRIS_STREAM_H
@@ -1,6 +1,6 @@
 //======================================================================================================================
 // File Name    : tetris.h
-// Description  : Implementation of tetris using ncurses, accessed through a global struct `tetris`
+// Description  : Implementation of tetris, accessed through a global struct `tetris`
 // Authors      : Liam Lawrence
 // Created      : December 17, 2020
 // License      : MIT License
@@ -10,16 +10,23 @@
 #ifndef TETRIS_TETRIS_H
 #define TETRIS_TETRIS_H
 
-#include <ncurses.h>
+#include "engine.h"
+#include "render.h"
 
 typedef struct{
     struct {
-        WINDOW *playfield;
-        WINDOW *scoreboard;
-        WINDOW *nextp;
-    } windows;
+        unsigned seed;              // seed for the tetromino bag
+        const char *record;         // replay file to write, NULL to not record
+        const renderer_t *renderer; // backend that draws the game, NULL for ncurses
+        int das;                    // ticks a direction is held before it repeats
+        int arr;                    // ticks between repeats after that, 0 to slide to the wall
+        const char *stream;         // spectator ring file to write, NULL to not stream, see stream.h
+        const char *checkpoint;     // file the game is saved to as it goes and resumed from, NULL for none
+        int repeat_delay;           // the terminal's key repeat delay in ms, 0 if unknown, see `input_open()`
+    } options;
     void (*init)(void);
     int (*run)(void);
+    void (*draw)(const engine_t *game);     // draw a single frame, `run()` does this itself
     void (*close)(void);
 } tetris_t;
 extern tetris_t tetris;
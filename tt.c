@@ -0,0 +1,80 @@
+//======================================================================================================================
+// File Name    : tt.c
+// Description  : Transposition table, one entry per slot and always replaced. Entries are read and written with relaxed
+//                atomics and checked with the XOR trick, so any number of search threads can share one table
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#include <stdlib.h>
+#include "tt.h"
+
+// MACROS //
+#define CACHE_LINE          64
+
+
+// FUNCTIONS //---------------------------------------------------------------------------------------------------------
+// allocate the largest power of two number of entries that fits in `bytes`, returns 0 on success
+int tt_init(tt_t *T, const size_t bytes)
+{
+    size_t count = 1;
+
+    while (count * 2 * sizeof(tt_entry_t) <= bytes)
+        count *= 2;
+    T->entries = aligned_alloc(CACHE_LINE, count * sizeof(tt_entry_t) < CACHE_LINE ? CACHE_LINE
+                                                                                   : count * sizeof(tt_entry_t));
+    if (!T->entries)
+        return -1;
+    T->mask = count - 1;
+    tt_clear(T);
+    return 0;
+}
+
+void tt_free(tt_t *T)
+{
+    free(T->entries);
+    T->entries = NULL;
+}
+
+// forget every entry, not safe while other threads use the table
+void tt_clear(tt_t *T)
+{
+    for (uint64_t i = 0; i <= T->mask; i++) {
+        atomic_init(&T->entries[i].check, 0);
+        atomic_init(&T->entries[i].data, 0);
+    }
+}
+
+// the position key: the board's Zobrist hash with the two pieces mixed in
+uint64_t tt_key(const uint64_t hash, const shapes_t piece, const shapes_t next)
+{
+    uint64_t z = ((uint64_t)piece << 8 | (uint64_t)next) * 0x9E3779B97F4A7C15ull;
+
+    z ^= z >> 29;
+    return hash ^ z;
+}
+
+// returns true and fills `score` and `depth` when `key` is in the table
+bool tt_probe(const tt_t *T, const uint64_t key, int32_t *score, int *depth)
+{
+    tt_entry_t *e = &T->entries[key & T->mask];
+    uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+
+    if ((check ^ data) != key || !data)
+        return false;
+    *score = (int32_t)(uint32_t)data;
+    *depth = (int)(data >> 32) - 1;
+    return true;
+}
+
+void tt_store(tt_t *T, const uint64_t key, const int32_t score, const int depth)
+{
+    tt_entry_t *e = &T->entries[key & T->mask];
+    uint64_t data = (uint64_t)(uint32_t)score | (uint64_t)(depth + 1) << 32;
+
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+}
@@ -0,0 +1,42 @@
+//======================================================================================================================
+// File Name    : tt.h
+// Description  : Fixed-size, lock-free transposition table for search: remembers the score of a position keyed by the
+//                board hash, the current piece and the next piece, so boards reached by different move orders are only
+//                evaluated once
+// Authors      : Liam Lawrence
+// Created      : December 17, 2020
+// License      : MIT License
+// Copyright    : (c) 2020, Liam Lawrence
+//======================================================================================================================
+
+#ifndef TETRIS_TT_H
+#define TETRIS_TT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "engine.h"
+
+// TYPEDEFS //
+// `check` is the key XORed with `data`, so an entry torn by two threads writing at once no longer matches any key
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;              // score in the low 32 bits, search depth above it
+} tt_entry_t;
+
+typedef struct {
+    tt_entry_t *entries;
+    uint64_t mask;                      // entry count - 1, the count is a power of two
+} tt_t;
+
+
+// PROTOTYPES //
+int tt_init(tt_t *T, size_t bytes);
+void tt_free(tt_t *T);
+void tt_clear(tt_t *T);
+uint64_t tt_key(uint64_t hash, shapes_t piece, shapes_t next);
+bool tt_probe(const tt_t *T, uint64_t key, int32_t *score, int *depth);
+void tt_store(tt_t *T, uint64_t key, int32_t score, int depth);
+
+#endif //TETRIS_TT_H
@@ -0,0 +1,162 @@
+#include <locale.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "input.h"
+#include "render.h"
+#include "stream.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static double now_s(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+// read exactly `n` bytes, false on EOF or an error
+static bool read_all(const int fd, uint8_t *buf, size_t n)
+{
+    ssize_t got;
+
+    while (n) {
+        if ((got = read(fd, buf, n)) <= 0)
+            return false;
+        buf += got;
+        n -= (size_t)got;
+    }
+    return true;
+}
+
+static bool write_all(const int fd, const uint8_t *buf, size_t n)
+{
+    ssize_t put;
+
+    while (n) {
+        if ((put = write(fd, buf, n)) <= 0)
+            return false;
+        buf += put;
+        n -= (size_t)put;
+    }
+    return true;
+}
+
+// Follow the spectator stream of a game, from the ring file a `tetris -S file` writes or piped in on stdin ('-').
+// The game is drawn as it goes, or with -c the stream is copied to stdout for a watcher somewhere else
+int main(int argc, char *argv[])
+{
+    static uint8_t buf[STREAM_RING_SIZE];
+    static stream_decoder_t D;
+    const renderer_t *R = &render_curses;
+    stream_reader_t reader = {.ring = NULL};
+    struct sigaction sa = {.sa_handler = on_signal};
+    struct pollfd in = {.fd = STDIN_FILENO, .events = POLLIN};
+    key_event_t keys[INPUT_MAX_EVENTS];
+    uint8_t pre[STREAM_PREAMBLE], got[STREAM_PREAMBLE];
+    uint64_t bytes = 0;
+    bool copy = false, piped, bad = false;
+    double start;
+    ssize_t n;
+    int opt, count;
+    char status[128];
+
+    while ((opt = getopt(argc, argv, "cR:")) != -1) {
+        switch (opt) {
+            case 'c':
+                copy = true;
+                break;
+            case 'R':
+                if (!(R = render_find(optarg))) {
+                    fprintf(stderr, "%s: no renderer '%s', try curses or ansi\n", argv[0], optarg);
+                    return 2;
+                }
+                break;
+            default:
+                optind = argc;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-c] [-R curses|ansi] stream-file|-\n", argv[0]);
+        return 2;
+    }
+
+    // a piped stream starts with the preamble, the ring file has the same in its header
+    piped = !strcmp(argv[optind], "-");
+    stream_preamble(pre);
+    if (piped && (!read_all(STDIN_FILENO, got, sizeof(got)) || memcmp(pre, got, sizeof(pre)) != 0)) {
+        fprintf(stderr, "%s: stdin is not a stream of this version\n", argv[0]);
+        return 1;
+    }
+    if (!piped && stream_attach(&reader, argv[optind])) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (copy && !write_all(STDOUT_FILENO, pre, sizeof(pre)))
+        return 1;
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    if (!copy) {
+        setlocale(LC_ALL, "");
+        R->init();
+        if (!piped)
+            input_open(0);      // the keyboard is only ours when the stream is not on stdin
+        R->reset();
+    }
+
+    // the ring is polled once a tick, it has no way to wake its readers without slowing the writer down
+    start = now_s();
+    while (!stop && !D.ended && !bad) {
+        if (piped) {
+            if ((n = read(STDIN_FILENO, buf, sizeof(buf))) <= 0)
+                break;
+        } else {
+            poll(&in, 1, TICK_US / 1000);
+            n = (ssize_t)stream_read(&reader, buf, sizeof(buf));
+            count = input_drain(keys, INPUT_MAX_EVENTS);
+            for (int i = 0; i < count; i++)
+                if (keys[i].type == KEY_PRESS
+                    && (keys[i].key == 'x' || keys[i].key == 'q' || keys[i].key == ('c' & 0x1f)))
+                    stop = 1;
+        }
+        if (!n)
+            continue;
+        bytes += (uint64_t)n;
+        if (stream_decode(&D, buf, (size_t)n) < 0)
+            bad = true;
+        else if (copy)
+            bad = !write_all(STDOUT_FILENO, buf, (size_t)n);
+        else if (D.synced)
+            R->draw(&D.game);
+    }
+
+    snprintf(status, sizeof(status), "%llu bytes in %.1f s (%.1f B/s), %llu records, %llu keyframes, %llu resyncs",
+             (unsigned long long)bytes, now_s() - start, (double)bytes / (now_s() - start),
+             (unsigned long long)D.records, (unsigned long long)D.keyframes, (unsigned long long)reader.resyncs);
+    if (!copy) {
+        if (D.ended) {
+            R->game_over("\n            GAME OVER\n", status);
+            while (!stop && !piped && !(poll(&in, 1, -1) > 0 && input_drain(keys, INPUT_MAX_EVENTS)))
+                ;
+        }
+        if (!piped)
+            input_close();
+        R->close();
+    }
+    stream_detach(&reader);
+    fprintf(stderr, "%s%s\n", bad ? "not a stream, stopped after " : "", status);
+    return bad;
+}